@@ -47,8 +47,11 @@
 #include "hipsens-eond.h"
 #include "hipsens-eostc.h"
 #include "hipsens-oserena.h"
+#include "hipsens-central-coloring.h"
 #include "hipsens-opera.h"
 #include "hipsens-opera-coloring.h"
+#include "hipsens-snapshot.h"
+#include "hipsens-checkpoint.h"
 
 /*---------------------------------------------------------------------------*/
 
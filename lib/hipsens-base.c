@@ -29,6 +29,10 @@
 #include "hipsens-config.h"
 #include "hipsens-base.h"
 #include "hipsens-all.h" //added-ridha
+
+#if defined(WITH_OPERA_PROFILE) && !defined(IS_EMBEDDED)
+#include <time.h>
+#endif
 /*---------------------------------------------------------------------------*/
 
 hipsens_time_t undefined_time = -11; //XXX: arbitrary //SEC_TO_HIPSENS_TIME(0);
@@ -111,7 +115,9 @@ void buffer_get_data(buffer_t* buffer, byte* data, int size)
   }
 }
 
-#ifdef WITH_LONG_PRIORITY
+#if defined(WITH_LONG_PRIORITY) || defined(WITH_OPERA_SNAPSHOT) \
+  || defined(WITH_OPERA_TRACE) || defined(WITH_OPERA_METRICS) \
+  || defined(WITH_OPERA_PROFILE) || defined(WITH_OPERA_CHECKPOINT)
 void buffer_put_u32(buffer_t* buffer, hipsens_u32 data)
 {
   if (buffer->pos + 4 <= buffer->size) {
@@ -137,7 +143,27 @@ hipsens_u32 buffer_get_u32(buffer_t* buffer)
     return 0; /* default value in case of overflow*/
   }
 }
-#endif /* WITH_LONG_PRIORITY */
+#endif /* WITH_LONG_PRIORITY || WITH_OPERA_SNAPSHOT || WITH_OPERA_TRACE */
+
+#if defined(WITH_OPERA_CHECKPOINT) || defined(WITH_OPERA_COLOR_SUPPRESSION) \
+  || defined(WITH_OPERA_ADAPTIVE_COLOR_INTERVAL)
+/* CRC-16 (CCITT polynomial 0x1021) of `size' bytes, continued from
+   `checksum' (0 for the first block); unlike a Fletcher-16 (sums modulo
+   255), it tells a byte 0x00 from a byte 0xff */
+hipsens_u16 data_checksum(hipsens_u16 checksum, byte* data, int size)
+{
+  int i, j;
+  for (i=0; i<size; i++) {
+    checksum ^= ((hipsens_u16)data[i]) << 8;
+    for (j=0; j<8; j++) {
+      if (checksum & 0x8000u)
+	checksum = (checksum << 1) ^ 0x1021u;
+      else checksum = checksum << 1;
+    }
+  }
+  return checksum;
+}
+#endif /* WITH_OPERA_CHECKPOINT || WITH_OPERA_COLOR_SUPPRESSION || ... */
 
 /*---------------------------------------------------------------------------*/
 /*                                  Utils                                    */
@@ -526,6 +552,18 @@ void base_state_init(base_state_t* state, void* opaque_extra_info)
   state->warning_count = 0;
   state->error_count = 0;
 
+#ifdef WITH_OPERA_TRACE
+  state->trace.count = 0;
+#endif /* WITH_OPERA_TRACE */
+
+#ifdef WITH_OPERA_METRICS
+  base_state_reset_metrics(state);
+#endif /* WITH_OPERA_METRICS */
+
+#ifdef WITH_OPERA_PROFILE
+  base_state_reset_profile(state);
+#endif /* WITH_OPERA_PROFILE */
+
 #ifdef WITH_OPERA_SYSTEM_INFO
   state->sys_info = 0;
   state->sys_info_color = 0;
@@ -553,6 +591,106 @@ void base_state_init(base_state_t* state, void* opaque_extra_info)
 void base_state_abort(base_state_t* state)
 { hipsens_abort(); }
 
+#ifdef WITH_OPERA_TRACE
+int base_state_trace_dump(base_state_t* state, hipsens_u16* seq_num,
+			  byte* data, int max_size)
+{
+  trace_ring_t* ring = &state->trace;
+  HIPSENS_GET_MY_ADDRESS(state, my_address);
+  if (max_size < OPERA_TRACE_HEADER_SIZE)
+    return -1;
+
+  /* skip records that were overwritten */
+  hipsens_u16 nb_available = ring->count - *seq_num;
+  if (nb_available > OPERA_TRACE_SIZE)
+    *seq_num = ring->count - OPERA_TRACE_SIZE;
+
+  buffer_t buffer;
+  buffer_init(&buffer, data, max_size);
+  buffer_put_u8(&buffer, OPERA_TRACE_MAGIC_1);
+  buffer_put_u8(&buffer, OPERA_TRACE_MAGIC_2);
+  buffer_put_u8(&buffer, OPERA_TRACE_VERSION);
+  buffer_put_u8(&buffer, ADDRESS_SIZE);
+  buffer_put_ADDRESS(&buffer, my_address);
+  int nb_record_pos = buffer.pos;
+  buffer_put_u8(&buffer, 0); /* nb-record, filled later */
+
+  hipsens_u8 nb_record = 0;
+  while (*seq_num != ring->count && nb_record < 0xff
+	 && buffer_remaining(&buffer) >= OPERA_TRACE_RECORD_SIZE) {
+    trace_record_t* record = &ring->record[*seq_num & (OPERA_TRACE_SIZE-1)];
+    int i;
+    buffer_put_u16(&buffer, *seq_num);
+    buffer_put_u8(&buffer, record->event);
+    buffer_put_u32(&buffer, (hipsens_u32)record->time);
+    for (i=0; i<OPERA_TRACE_NB_ARG; i++)
+      buffer_put_u16(&buffer, record->arg[i]);
+    (*seq_num)++;
+    nb_record++;
+  }
+  data[nb_record_pos] = nb_record;
+  return buffer.pos;
+}
+#endif /* WITH_OPERA_TRACE */
+
+#ifdef WITH_OPERA_METRICS
+hipsens_u32 base_state_get_metric(base_state_t* state, opera_metric_t metric)
+{
+  if ((int)metric < 0 || metric >= OPERA_METRIC_NB)
+    return 0;
+  return state->metric[metric];
+}
+
+void base_state_reset_metrics(base_state_t* state)
+{
+  int i;
+  for (i=0; i<OPERA_METRIC_NB; i++)
+    state->metric[i] = 0;
+}
+#endif /* WITH_OPERA_METRICS */
+
+#ifdef WITH_OPERA_PROFILE
+#ifndef IS_EMBEDDED
+hipsens_u32 base_profile_clock(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (hipsens_u32)now.tv_sec * 1000000u 
+    + (hipsens_u32)(now.tv_nsec / 1000);
+}
+#endif /* !IS_EMBEDDED */
+
+void base_state_profile_add(base_state_t* state, opera_profile_point_t point,
+			    hipsens_u32 duration)
+{
+  if ((int)point < 0 || point >= OPERA_PROFILE_NB)
+    return;
+  profile_histogram_t* histogram = &state->profile[point];
+
+  int bucket = 0;
+  hipsens_u32 value = duration;
+  while (value != 0 && bucket < OPERA_PROFILE_NB_BUCKET-1) {
+    value >>= 1;
+    bucket++;
+  }
+  if (histogram->count[bucket] != 0xffffu)
+    histogram->count[bucket]++;
+  if (duration > histogram->max_duration)
+    histogram->max_duration = duration;
+}
+
+profile_histogram_t* base_state_get_profile(base_state_t* state,
+					    opera_profile_point_t point)
+{
+  if ((int)point < 0 || point >= OPERA_PROFILE_NB)
+    return NULL;
+  return &state->profile[point];
+}
+
+void base_state_reset_profile(base_state_t* state)
+{ memset(state->profile, 0, sizeof(state->profile)); }
+#endif /* WITH_OPERA_PROFILE */
+
 #ifdef WITH_OPERA_INPACKET_MSG
 #warning "[CA] remove WITH_OPERA_INPACKET_MSG in production code (consumes [flash] memory)"
 void base_state_set_info(base_state_t* state, hipsens_u8 info_type, 
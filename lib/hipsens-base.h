@@ -259,10 +259,16 @@ void buffer_get_data(buffer_t* buffer, byte* data, int size);
 #define buffer_get_u8 buffer_get_byte
 #define buffer_put_u16 buffer_put_short
 #define buffer_get_u16 buffer_get_short
-#ifdef WITH_LONG_PRIORITY
+#if defined(WITH_LONG_PRIORITY) || defined(WITH_OPERA_SNAPSHOT) \
+  || defined(WITH_OPERA_TRACE) || defined(WITH_OPERA_METRICS) \
+  || defined(WITH_OPERA_PROFILE) || defined(WITH_OPERA_CHECKPOINT)
 void buffer_put_u32(buffer_t* buffer, hipsens_u32 data);
 hipsens_u32 buffer_get_u32(buffer_t* buffer);
-#endif /* WITH_LONG_PRIORITY - XXX: ifdef should be more general */
+#endif /* WITH_LONG_PRIORITY || WITH_OPERA_SNAPSHOT || WITH_OPERA_TRACE */
+#if defined(WITH_OPERA_CHECKPOINT) || defined(WITH_OPERA_COLOR_SUPPRESSION) \
+  || defined(WITH_OPERA_ADAPTIVE_COLOR_INTERVAL)
+hipsens_u16 data_checksum(hipsens_u16 checksum, byte* data, int size);
+#endif /* WITH_OPERA_CHECKPOINT || WITH_OPERA_COLOR_SUPPRESSION || ... */
 #define buffer_remaining(buffer) ((buffer)->size - (buffer)->pos)
 
 #define buffer_put_ADDRESS(buffer, data) \
@@ -334,6 +340,146 @@ void bitset_pywrite(outstream_t out, byte* data, int max_bit);
 #define ENERGY_RECEPTION 0
 #define ENERGY_TRANSMISSION 1
 
+/*--------------------------------------------------
+ * Binary trace
+ * (fixed-size records in a ring, decoded offline by tools/OperaTrace.py)
+ *--------------------------------------------------*/
+
+#ifdef WITH_OPERA_TRACE
+
+/* must be a power of 2 */
+#ifndef OPERA_TRACE_SIZE
+#define OPERA_TRACE_SIZE 32
+#endif
+
+#if OPERA_TRACE_SIZE <= 0 || (OPERA_TRACE_SIZE & (OPERA_TRACE_SIZE-1)) != 0
+#error "OPERA_TRACE_SIZE must be a power of 2"
+#endif
+
+#define OPERA_TRACE_NB_ARG 3
+
+/* the identifiers are part of the trace format: only append new ones
+   (and update tools/OperaTrace.py) */
+typedef enum {
+  OPERA_TRACE_NONE = 0,
+  OPERA_TRACE_WARNING = 1,
+  OPERA_TRACE_FATAL = 2,
+  OPERA_TRACE_PACKET_RECEIVED = 3,
+  OPERA_TRACE_PACKET_GENERATED = 4,
+
+  OPERA_TRACE_EOND_HELLO_RECEIVED = 0x10,
+  OPERA_TRACE_EOND_HELLO_GENERATED = 0x11,
+  OPERA_TRACE_EOND_NEW_NEIGHBOR = 0x12,
+  OPERA_TRACE_EOND_NEIGHBOR_TABLE_FULL = 0x13,
+  OPERA_TRACE_EOND_NEIGHBOR_STATE_CHANGE = 0x14,
+
+  OPERA_TRACE_EOSTC_STC_RECEIVED = 0x20,
+  OPERA_TRACE_EOSTC_STC_GENERATED = 0x21,
+  OPERA_TRACE_EOSTC_STC_REPEATED = 0x22,
+  OPERA_TRACE_EOSTC_TREE_STATUS_GENERATED = 0x23,
+  OPERA_TRACE_EOSTC_TREE_TABLE_FULL = 0x24,
+
+  OPERA_TRACE_SERENA_COLOR_RECEIVED = 0x30,
+  OPERA_TRACE_SERENA_COLOR_GENERATED = 0x31,
+  OPERA_TRACE_SERENA_START = 0x32
+} opera_trace_event_t;
+
+typedef struct s_trace_record_t {
+  hipsens_time_t time;
+  hipsens_u16 arg[OPERA_TRACE_NB_ARG];
+  hipsens_u8 event;
+} trace_record_t;
+
+/** Written only by the node itself (no lock): `count' is incremented
+    after the record is filled, and a reader detects overwritten records
+    by comparing its own sequence number with `count' */
+typedef struct s_trace_ring_t {
+  hipsens_u16 count; /**< total number of records written (wraps) */
+  trace_record_t record[OPERA_TRACE_SIZE];
+} trace_ring_t;
+
+/** the 16 lower bits of an address, as stored in trace records */
+#define TRACE_ADDRESS(address) \
+  ((((hipsens_u16)(address)[ADDRESS_SIZE-2]) << 8) \
+   | ((hipsens_u16)(address)[ADDRESS_SIZE-1]))
+
+#endif /* WITH_OPERA_TRACE */
+
+/*--------------------------------------------------
+ * Metrics
+ * (counters of protocol overhead, for all modules)
+ *--------------------------------------------------*/
+
+#ifdef WITH_OPERA_METRICS
+
+/* the identifiers are used by the serial command OPERA_GET_METRICS:
+   only append new ones */
+typedef enum {
+  OPERA_METRIC_HELLO_GENERATED = 0,
+  OPERA_METRIC_HELLO_PARSED = 1,
+  OPERA_METRIC_STC_GENERATED = 2, /**< including repeated STC */
+  OPERA_METRIC_STC_PARSED = 3,
+  OPERA_METRIC_TREE_STATUS_GENERATED = 4,
+  OPERA_METRIC_TREE_STATUS_PARSED = 5,
+  OPERA_METRIC_COLOR_GENERATED = 6,
+  OPERA_METRIC_COLOR_PARSED = 7,
+  OPERA_METRIC_BYTES_SENT = 8,
+  OPERA_METRIC_PARSE_ERROR = 9,
+  OPERA_METRIC_NEIGHBOR_TABLE_FULL = 10, /**< new neighbor dropped */
+  OPERA_METRIC_TREE_TABLE_FULL = 11, /**< new tree dropped */
+  OPERA_METRIC_CHILD_TABLE_FULL = 12, /**< new child dropped */
+  OPERA_METRIC_PARENT_CHANGE = 13,
+  OPERA_METRIC_COLORING_START = 14, /**< SERENA (re)started on this node */
+  OPERA_METRIC_COLOR_SUPPRESSED = 15, /**< unchanged Color message skipped */
+  OPERA_METRIC_NB = 16
+} opera_metric_t;
+
+#endif /* WITH_OPERA_METRICS */
+
+/*--------------------------------------------------
+ * Profile
+ * (durations of the processing, as log-scale histograms)
+ *--------------------------------------------------*/
+
+#ifdef WITH_OPERA_PROFILE
+
+/* OPERA_PROFILE_CLOCK() must return a free-running hipsens_u32 counter
+   (e.g. a hardware timer on the nodes) ; only differences are used.
+   On a host, the default is a microsecond clock (clock_gettime) */
+#ifndef OPERA_PROFILE_CLOCK
+#ifdef IS_EMBEDDED
+#error "WITH_OPERA_PROFILE requires the definition of OPERA_PROFILE_CLOCK()"
+#else /* IS_EMBEDDED */
+hipsens_u32 base_profile_clock(void);
+#define OPERA_PROFILE_CLOCK() base_profile_clock()
+#endif /* IS_EMBEDDED */
+#endif /* OPERA_PROFILE_CLOCK */
+
+/* bucket 0 counts durations of 0 clock ticks, bucket i (i>0) durations
+   in [2^(i-1), 2^i[, and the last bucket all the longer ones */
+#ifndef OPERA_PROFILE_NB_BUCKET
+#define OPERA_PROFILE_NB_BUCKET 16
+#endif
+
+/* the identifiers are used by the serial command OPERA_GET_PROFILE:
+   only append new ones */
+typedef enum {
+  OPERA_PROFILE_NEW_CYCLE = 0,          /**< opera_event_new_cycle */
+  OPERA_PROFILE_WAKEUP_WITH_BUFFER = 1, /**< opera_event_wakeup_with_buffer */
+  OPERA_PROFILE_PACKET_RECEIVED = 2,    /**< opera_event_packet_received */
+  OPERA_PROFILE_EOND = 3,   /**< one message generation or processing */
+  OPERA_PROFILE_EOSTC = 4,  /**< idem */
+  OPERA_PROFILE_SERENA = 5, /**< idem */
+  OPERA_PROFILE_NB = 6
+} opera_profile_point_t;
+
+typedef struct s_profile_histogram_t {
+  hipsens_u32 max_duration;
+  hipsens_u16 count[OPERA_PROFILE_NB_BUCKET]; /**< saturating at 0xffff */
+} profile_histogram_t;
+
+#endif /* WITH_OPERA_PROFILE */
+
 /*--------------------------------------------------*/
 
 #define OPERA_MAX_COMMAND_SIZE 10
@@ -366,7 +512,19 @@ typedef struct s_base_state_t {
   char str_info[30];
   int int_info;
 #endif
-  
+
+#ifdef WITH_OPERA_TRACE
+  trace_ring_t trace;
+#endif /* WITH_OPERA_TRACE */
+
+#ifdef WITH_OPERA_METRICS
+  hipsens_u32 metric[OPERA_METRIC_NB];
+#endif /* WITH_OPERA_METRICS */
+
+#ifdef WITH_OPERA_PROFILE
+  profile_histogram_t profile[OPERA_PROFILE_NB];
+#endif /* WITH_OPERA_PROFILE */
+
   hipsens_u8 warning_count;
   hipsens_u8 error_count;
 } base_state_t;
@@ -377,6 +535,49 @@ void base_state_abort(base_state_t* state);
 hipsens_time_t base_state_time_after_delay_jitter
 (base_state_t* base_state, hipsens_time_t delay, hipsens_time_t jitter);
 
+#ifdef WITH_OPERA_TRACE
+#define OPERA_TRACE_MAGIC_1 'T'
+#define OPERA_TRACE_MAGIC_2 'R'
+#define OPERA_TRACE_VERSION 1
+#define OPERA_TRACE_HEADER_SIZE (5+ADDRESS_SIZE)
+#define OPERA_TRACE_RECORD_SIZE (2+1+4+2*OPERA_TRACE_NB_ARG)
+
+/**
+ * Copy the trace records with sequence numbers starting from `*seq_num'
+ * in `data' as a block:
+ *   'T' 'R' version address-size address nb-record(1)
+ * followed by the records:
+ *   seq-num(2) event(1) time(4) arg(2) x OPERA_TRACE_NB_ARG
+ * Records that were already overwritten are skipped. `*seq_num' is
+ * updated to the sequence number following the last copied record.
+ * Returns the size of the block, or -1 if `max_size' is too small for
+ * the header.
+ */
+int base_state_trace_dump(base_state_t* state, hipsens_u16* seq_num,
+			  byte* data, int max_size);
+#endif /* WITH_OPERA_TRACE */
+
+#ifdef WITH_OPERA_METRICS
+/** Returns the value of one counter (0 if `metric' is unknown) */
+hipsens_u32 base_state_get_metric(base_state_t* state, opera_metric_t metric);
+
+/** Resets all the counters to 0 */
+void base_state_reset_metrics(base_state_t* state);
+#endif /* WITH_OPERA_METRICS */
+
+#ifdef WITH_OPERA_PROFILE
+/** Adds one measured `duration' (in OPERA_PROFILE_CLOCK ticks) */
+void base_state_profile_add(base_state_t* state, opera_profile_point_t point,
+			    hipsens_u32 duration);
+
+/** Returns the histogram of one profile point (NULL if unknown) */
+profile_histogram_t* base_state_get_profile(base_state_t* state,
+					    opera_profile_point_t point);
+
+/** Resets all the histograms */
+void base_state_reset_profile(base_state_t* state);
+#endif /* WITH_OPERA_PROFILE */
+
 /*---------------------------------------------------------------------------*/
 
 #define DEFAULT_JITTER_MILLISEC 500 /* millisec */
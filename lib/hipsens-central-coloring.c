@@ -0,0 +1,792 @@
+/*---------------------------------------------------------------------------
+ *               OPERA - Centralized Coloring at the Tree Root
+ *---------------------------------------------------------------------------
+ * Author: agent
+ * Copyright 2026 agent.
+ *
+ * This file is part of the OPERA.
+ *
+ * The OPERA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * The OPERA is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+ * http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *---------------------------------------------------------------------------*/
+
+#include <string.h>
+
+#include "hipsens-all.h"
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+
+/*---------------------------------------------------------------------------*/
+
+/* header of the Neighbor Report: type, size, sender, destination, root,
+   tree seq. num, origin, parent of the origin, flags, nb. address */
+#define CENTRAL_REPORT_HEADER_SIZE (2 + 5*ADDRESS_SIZE + 2 + 2)
+#define CENTRAL_REPORT_FLAG_LAST 0x01u
+
+/* position of the addresses rewritten when a message is forwarded */
+#define CENTRAL_SENDER_POS 2
+#define CENTRAL_DESTINATION_POS (2 + ADDRESS_SIZE)
+
+static void opera_central_graph_init(opera_central_graph_t* graph)
+{
+  graph->is_collecting = HIPSENS_FALSE;
+  graph->is_overflow = HIPSENS_FALSE;
+  graph->is_computed = HIPSENS_FALSE;
+  graph->tree_seq_num = 0;
+  graph->expected_nb_node = 0;
+  graph->nb_reported = 0;
+  graph->nb_node = 0;
+  graph->nb_round = 0;
+  graph->burst_seq_num = 0;
+  graph->next_chunk_index = 0;
+  graph->next_burst_time = undefined_time;
+}
+
+void opera_central_init(opera_central_state_t* central)
+{
+  /* `graph' is kept (see opera_central_set_graph) */
+  if (central->graph != NULL)
+    opera_central_graph_init(central->graph);
+
+  central->is_reporting = HIPSENS_FALSE;
+  central->report_next_index = 0;
+  central->next_report_time = undefined_time;
+  central->forwarded_burst_seq_num = 0;
+  central->forwarded_chunk_set = 0;
+  central->queue_head = 0;
+  central->queue_count = 0;
+}
+
+void opera_central_set_graph(opera_state_t* state,
+			     opera_central_graph_t* graph)
+{
+  state->central_state.graph = graph;
+  if (graph != NULL)
+    opera_central_graph_init(graph);
+}
+
+/* the colored tree of root `root_address' (NULL if none) */
+static eostc_tree_t* opera_central_find_tree(opera_state_t* state,
+					     address_t root_address)
+{
+  eostc_state_t* eostc_state = &state->eostc_state;
+  int i;
+  for (i=0; i<EOSTC_MAX_SERENA_TREE(eostc_state); i++) {
+    eostc_tree_t* tree = &eostc_state->tree[i];
+    if (tree->status != EOSTC_None && IS_FOR_SERENA(*tree)
+	&& hipsens_address_equal(tree->root_address, root_address))
+      return tree;
+  }
+  return NULL;
+}
+
+static hipsens_bool opera_central_has_child(eostc_tree_t* tree)
+{
+  eostc_serena_tree_t* serena_tree = tree->serena_info;
+  int i;
+  for (i=0; i<EOSTC_MAX_CHILD(serena_tree); i++)
+    if (serena_tree->child[i].status != Child_None)
+      return HIPSENS_TRUE;
+  return HIPSENS_FALSE;
+}
+
+/* queues a copy of a received message, sent again by this node */
+static hipsens_bool opera_central_enqueue(opera_state_t* state,
+					  byte* message, int message_size)
+{
+  opera_central_state_t* central = &state->central_state;
+  if (central->queue_count >= OPERA_CENTRAL_QUEUE_SIZE
+      || message_size > MAX_PACKET_SIZE) {
+    STWARN("central coloring: forwarded message dropped.\n");
+    return HIPSENS_FALSE;
+  }
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  int index = (central->queue_head + central->queue_count)
+    % OPERA_CENTRAL_QUEUE_SIZE;
+  byte* queued_message = central->queue[index];
+  memcpy(queued_message, message, message_size);
+  hipsens_address_copy(queued_message + CENTRAL_SENDER_POS, my_address);
+  central->queue_size[index] = message_size;
+  central->queue_count ++;
+  return HIPSENS_TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+/* Root: collected graph */
+/*---------------------------------------------------------------------------*/
+
+/* starts the collection for `tree_seq_num' (unless already started) */
+static void opera_central_prepare(opera_state_t* state,
+				  hipsens_u16 tree_seq_num)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  if (graph->is_collecting && graph->tree_seq_num == tree_seq_num)
+    return;
+  state->serena_state.central_color = COLOR_NONE;
+  graph->is_collecting = HIPSENS_TRUE;
+  graph->is_overflow = HIPSENS_FALSE;
+  graph->is_computed = HIPSENS_FALSE;
+  graph->tree_seq_num = tree_seq_num;
+  graph->expected_nb_node = 0;
+  graph->nb_reported = 0;
+  graph->nb_node = 0;
+  graph->next_chunk_index = 0;
+  graph->next_burst_time = undefined_time;
+}
+
+/* index of the node of address `address', added if needed ; -1 if full */
+static int opera_central_get_node(opera_central_graph_t* graph,
+				  address_t address)
+{
+  int i;
+  for (i=0; i<graph->nb_node; i++)
+    if (hipsens_address_equal(graph->node[i].address, address))
+      return i;
+  if (graph->nb_node >= MAX_CENTRAL_NODE) {
+    graph->is_overflow = HIPSENS_TRUE;
+    return -1;
+  }
+  opera_central_node_t* node = &graph->node[graph->nb_node];
+  hipsens_address_copy(node->address, address);
+  hipsens_address_copy(node->parent_address, address); /* no parent */
+  node->color = COLOR_NONE;
+  node->has_reported = HIPSENS_FALSE;
+  node->nb_neighbor = 0;
+  return graph->nb_node++;
+}
+
+static void opera_central_add_arc(opera_central_graph_t* graph,
+				  int from_index, int to_index)
+{
+  opera_central_node_t* node = &graph->node[from_index];
+  int i;
+  for (i=0; i<node->nb_neighbor; i++)
+    if (node->neighbor[i] == to_index)
+      return;
+  if (node->nb_neighbor >= MAX_NEIGHBOR) {
+    graph->is_overflow = HIPSENS_TRUE;
+    return;
+  }
+  node->neighbor[node->nb_neighbor++] = to_index;
+}
+
+/* the edges are added in both directions: the graph stays symmetric
+   even if some report is truncated */
+static void opera_central_add_neighbor(opera_central_graph_t* graph,
+				       int node_index, address_t address)
+{
+  int neighbor_index = opera_central_get_node(graph, address);
+  if (neighbor_index < 0 || neighbor_index == node_index)
+    return;
+  opera_central_add_arc(graph, node_index, neighbor_index);
+  opera_central_add_arc(graph, neighbor_index, node_index);
+}
+
+static void opera_central_set_reported(opera_central_graph_t* graph,
+				       int node_index)
+{
+  if (!graph->node[node_index].has_reported) {
+    graph->node[node_index].has_reported = HIPSENS_TRUE;
+    graph->nb_reported ++;
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* Root: coloring engine */
+/*---------------------------------------------------------------------------*/
+
+/* sets the `distance' of all the nodes from `origin_index', up to
+   `max_distance' hops (CENTRAL_NODE_NONE beyond) */
+static void opera_central_mark_distance(opera_central_graph_t* graph,
+					int origin_index, int max_distance)
+{
+  hipsens_u8 queue[MAX_CENTRAL_NODE];
+  int head = 0, tail = 0;
+  int i;
+  for (i=0; i<graph->nb_node; i++)
+    graph->node[i].distance = CENTRAL_NODE_NONE;
+  graph->node[origin_index].distance = 0;
+  queue[tail++] = origin_index;
+  while (head < tail) {
+    opera_central_node_t* node = &graph->node[queue[head++]];
+    if (node->distance >= max_distance)
+      continue;
+    for (i=0; i<node->nb_neighbor; i++) {
+      opera_central_node_t* neighbor = &graph->node[node->neighbor[i]];
+      if (neighbor->distance == CENTRAL_NODE_NONE) {
+	neighbor->distance = node->distance + 1;
+	queue[tail++] = node->neighbor[i];
+      }
+    }
+  }
+}
+
+/* same order as the full priorities of SERENA: priority, then lowest
+   address */
+static hipsens_bool opera_central_is_before(opera_central_graph_t* graph,
+					    int index1, int index2)
+{
+  opera_central_node_t* node1 = &graph->node[index1];
+  opera_central_node_t* node2 = &graph->node[index2];
+  if (node1->priority != node2->priority)
+    return node1->priority > node2->priority;
+  return hipsens_address_cmp(node1->address, node2->address) < 0;
+}
+
+#define IS_CENTRAL_UNCOLORED(node) \
+  ((node)->has_reported && (node)->color == COLOR_NONE)
+
+static void opera_central_set_priority(opera_state_t* state)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  serena_config_t* serena_config = &state->config->serena_config;
+  int i,j;
+
+  for (i=0; i<graph->nb_node; i++)
+    graph->node[i].priority = 0;
+
+  if (serena_config->priority_mode == Priority_mode_tree) {
+    /* number of descendants (including the node itself) */
+    for (i=0; i<graph->nb_node; i++) {
+      if (!graph->node[i].has_reported)
+	continue;
+      int ancestor_index = i;
+      for (j=0; j<graph->nb_node && ancestor_index != CENTRAL_NODE_NONE;
+	   j++) {
+	graph->node[ancestor_index].priority ++;
+	ancestor_index = graph->node[ancestor_index].parent_index;
+      }
+    }
+  } else if (serena_config->priority_mode == Priority_mode_fixed) {
+    for (i=0; i<graph->nb_node; i++)
+      graph->node[i].priority = GET_PRIORITY(serena_config->fixed_priority);
+  } else {
+    /* number of 1-hop and 2-hop neighbors */
+    for (i=0; i<graph->nb_node; i++) {
+      opera_central_mark_distance(graph, i, 2);
+      for (j=0; j<graph->nb_node; j++)
+	if (graph->node[j].distance == 1 || graph->node[j].distance == 2)
+	  graph->node[i].priority ++;
+    }
+  }
+}
+
+/* the lowest color which is not used at distance <= conflict distance
+   of the node (and above the color of its parent with Priority_mode_tree), or -1 */
+static int opera_central_choose_color(opera_state_t* state, int node_index)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  opera_central_node_t* node = &graph->node[node_index];
+  bitmap_t used_color_bitmap;
+  int i;
+
+  bitmap_init(&used_color_bitmap);
+  opera_central_mark_distance
+    (graph, node_index,
+     SERENA_CONFLICT_DISTANCE(&state->config->serena_config));
+  for (i=0; i<graph->nb_node; i++) {
+    opera_central_node_t* other = &graph->node[i];
+    if (i != node_index && other->distance != CENTRAL_NODE_NONE
+	&& other->color != COLOR_NONE)
+      bitmap_set_bit(&used_color_bitmap, other->color, &state->serena_state);
+  }
+
+  int min_color = 0;
+  if (state->config->serena_config.priority_mode == Priority_mode_tree
+      && node->parent_index != CENTRAL_NODE_NONE
+      && graph->node[node->parent_index].color != COLOR_NONE)
+    min_color = graph->node[node->parent_index].color;
+
+  for (i=min_color; i<NB_COLOR_MAX; i++)
+    if ((used_color_bitmap.content[BYTE_OF_BIT(i)]
+	 & MASK_OF_INDEX(INDEX_OF_BIT(i))) == 0)
+      return i;
+  return -1;
+}
+
+/*
+   Jones-Plassmann coloring of the reported nodes at the conflict distance.
+   The nodes selected in one round are farther from each other,
+   hence the colors of a round are independent of the order in which they
+   are chosen.
+   [ O(R N (N + E)) where R = nb. rounds, N = nb. nodes, E = nb. edges ]
+*/
+static hipsens_bool opera_central_compute(opera_state_t* state)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  int i,j;
+
+  for (i=0; i<graph->nb_node; i++) {
+    opera_central_node_t* node = &graph->node[i];
+    node->color = COLOR_NONE;
+    node->parent_index = CENTRAL_NODE_NONE;
+    if (!hipsens_address_equal(node->parent_address, node->address)) {
+      for (j=0; j<graph->nb_node; j++)
+	if (hipsens_address_equal(graph->node[j].address,
+				  node->parent_address))
+	  node->parent_index = j;
+    }
+  }
+  opera_central_set_priority(state);
+
+  graph->nb_round = 0;
+  for (;;) {
+    /* select the local maxima among the uncolored nodes */
+    int nb_selected = 0;
+    for (i=0; i<graph->nb_node; i++) {
+      opera_central_node_t* node = &graph->node[i];
+      node->is_selected = HIPSENS_FALSE;
+      if (!IS_CENTRAL_UNCOLORED(node))
+	continue;
+      opera_central_mark_distance
+	(graph, i, SERENA_CONFLICT_DISTANCE(&state->config->serena_config));
+      node->is_selected = HIPSENS_TRUE;
+      for (j=0; j<graph->nb_node; j++) {
+	opera_central_node_t* other = &graph->node[j];
+	if (j != i && other->distance != CENTRAL_NODE_NONE
+	    && IS_CENTRAL_UNCOLORED(other)
+	    && opera_central_is_before(graph, j, i)) {
+	  node->is_selected = HIPSENS_FALSE;
+	  break;
+	}
+      }
+      if (node->is_selected)
+	nb_selected ++;
+    }
+    if (nb_selected == 0)
+      break; /* all colored */
+
+    /* color them */
+    for (i=0; i<graph->nb_node; i++) {
+      if (!graph->node[i].is_selected)
+	continue;
+      int color = opera_central_choose_color(state, i);
+      if (color < 0) {
+	STWARN("central coloring: not enough colors.\n");
+	return HIPSENS_FALSE;
+      }
+      graph->node[i].color = color;
+    }
+    if (graph->nb_round < 0xff)
+      graph->nb_round ++;
+  }
+  return HIPSENS_TRUE;
+}
+
+/* computes the colors when all the reports have been received */
+static void opera_central_check_complete(opera_state_t* state)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  if (!graph->is_collecting || graph->is_computed
+      || graph->expected_nb_node == 0
+      || graph->nb_reported < graph->expected_nb_node)
+    return;
+
+  if (graph->is_overflow) {
+    STWARN("central coloring: table full, SERENA will color the tree.\n");
+    graph->is_collecting = HIPSENS_FALSE;
+    return;
+  }
+  if (!opera_central_compute(state)) {
+    graph->is_collecting = HIPSENS_FALSE;
+    return;
+  }
+  STLOGA(DBGsrn, "central-coloring nb-node=%d nb-round=%d\n",
+	 graph->nb_node, graph->nb_round);
+
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  int my_index = opera_central_get_node(graph, my_address);
+  if (my_index >= 0)
+    state->serena_state.central_color = graph->node[my_index].color;
+
+  graph->is_computed = HIPSENS_TRUE;
+  graph->next_chunk_index = 0;
+  graph->next_burst_time = state->base->current_time;
+}
+
+/* the root adds its own neighbors to the graph */
+static void opera_central_add_my_report(opera_state_t* state)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  eond_state_t* eond_state = &state->eond_state;
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+
+  int my_index = opera_central_get_node(graph, my_address);
+  if (my_index < 0)
+    return;
+  int i;
+  for (i=0; i<EOND_MAX_NEIGHBOR(eond_state); i++) {
+    eond_neighbor_t* neighbor = &eond_state->neighbor_table[i];
+    if (neighbor->state == EOND_Sym)
+      opera_central_add_neighbor(graph, my_index, neighbor->address);
+  }
+  opera_central_set_reported(graph, my_index);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void opera_central_start(opera_state_t* state, eostc_tree_t* tree)
+{
+  opera_central_state_t* central = &state->central_state;
+  if (!state->config->serena_config.central_coloring)
+    return;
+  ASSERT( IS_FOR_SERENA(*tree) );
+
+  if (tree->status == EOSTC_IsRoot) {
+    if (central->graph == NULL) {
+      STWARN("central coloring: no graph, SERENA will color the tree.\n");
+      return;
+    }
+    opera_central_prepare(state, tree->serena_info->tree_seq_num);
+    opera_central_add_my_report(state);
+    central->graph->expected_nb_node = eostc_count_descendant
+      (&state->eostc_state, tree);
+    opera_central_check_complete(state);
+  } else {
+    state->serena_state.central_color = COLOR_NONE;
+    central->is_reporting = HIPSENS_TRUE;
+    hipsens_address_copy(central->report_root_address, tree->root_address);
+    central->report_tree_seq_num = tree->serena_info->tree_seq_num;
+    central->report_next_index = 0;
+    central->next_report_time = state->base->current_time;
+  }
+}
+
+void opera_central_process_report(opera_state_t* state,
+				  byte* packet, int max_packet_size)
+{
+  opera_central_state_t* central = &state->central_state;
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  buffer_t buffer;
+  buffer_init(&buffer, packet, max_packet_size);
+
+  buffer_get_u8(&buffer); /* message type */
+  int message_size = buffer_get_u8(&buffer);
+  address_t sender_address, destination_address, root_address;
+  address_t origin_address, origin_parent_address;
+  buffer_get_ADDRESS(&buffer, sender_address);
+  buffer_get_ADDRESS(&buffer, destination_address);
+  buffer_get_ADDRESS(&buffer, root_address);
+  hipsens_u16 tree_seq_num = buffer_get_u16(&buffer);
+  buffer_get_ADDRESS(&buffer, origin_address);
+  buffer_get_ADDRESS(&buffer, origin_parent_address);
+  hipsens_u8 flags = buffer_get_u8(&buffer);
+  int nb_address = buffer_get_u8(&buffer);
+  if (buffer.status != HIPSENS_TRUE
+      || buffer_remaining(&buffer) < nb_address * ADDRESS_SIZE) {
+    STWARN("parse error in neighbor report message\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+
+  if (!state->config->serena_config.central_coloring
+      || !hipsens_address_equal(destination_address, my_address))
+    return;
+
+  eostc_tree_t* tree = opera_central_find_tree(state, root_address);
+  if (tree == NULL || tree->serena_info->tree_seq_num != tree_seq_num)
+    return; /* old tree, or unknown tree */
+
+  if (tree->status != EOSTC_IsRoot) {
+    /* forward towards the root */
+    int index = (central->queue_head + central->queue_count)
+      % OPERA_CENTRAL_QUEUE_SIZE;
+    if (opera_central_enqueue(state, packet, message_size + 2))
+      hipsens_address_copy(central->queue[index] + CENTRAL_DESTINATION_POS,
+			   tree->parent_address);
+    return;
+  }
+
+  /* root */
+  opera_central_graph_t* graph = central->graph;
+  if (graph == NULL)
+    return;
+  opera_central_prepare(state, tree_seq_num);
+  int origin_index = opera_central_get_node(graph, origin_address);
+  if (origin_index < 0)
+    return;
+  hipsens_address_copy(graph->node[origin_index].parent_address,
+		       origin_parent_address);
+  int i;
+  for (i=0; i<nb_address; i++) {
+    address_t neighbor_address;
+    buffer_get_ADDRESS(&buffer, neighbor_address);
+    opera_central_add_neighbor(graph, origin_index, neighbor_address);
+  }
+  if ((flags & CENTRAL_REPORT_FLAG_LAST) != 0)
+    opera_central_set_reported(graph, origin_index);
+  opera_central_check_complete(state);
+}
+
+void opera_central_process_assignment(opera_state_t* state,
+				      byte* packet, int max_packet_size)
+{
+  opera_central_state_t* central = &state->central_state;
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  buffer_t buffer;
+  buffer_init(&buffer, packet, max_packet_size);
+
+  buffer_get_u8(&buffer); /* message type */
+  int message_size = buffer_get_u8(&buffer);
+  address_t sender_address, root_address;
+  buffer_get_ADDRESS(&buffer, sender_address);
+  buffer_get_ADDRESS(&buffer, root_address);
+  hipsens_u16 tree_seq_num = buffer_get_u16(&buffer);
+  hipsens_u8 burst_seq_num = buffer_get_u8(&buffer);
+  hipsens_u8 chunk_index = buffer_get_u8(&buffer);
+  buffer_get_u8(&buffer); /* number of chunks */
+  int nb_entry = buffer_get_u8(&buffer);
+  if (buffer.status != HIPSENS_TRUE || buffer_remaining(&buffer)
+      < nb_entry * CENTRAL_ASSIGNMENT_ENTRY_SIZE) {
+    STWARN("parse error in color assignment message\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+
+  if (!state->config->serena_config.central_coloring)
+    return;
+  eostc_tree_t* tree = opera_central_find_tree(state, root_address);
+  if (tree == NULL || tree->status == EOSTC_IsRoot
+      || tree->serena_info->tree_seq_num != tree_seq_num)
+    return;
+
+  int i;
+  for (i=0; i<nb_entry; i++) {
+    address_t address;
+    buffer_get_ADDRESS(&buffer, address);
+    byte color = buffer_get_u8(&buffer);
+    if (hipsens_address_equal(address, my_address) && color < NB_COLOR_MAX
+	&& state->serena_state.central_color == COLOR_NONE)
+      state->serena_state.central_color = color;
+  }
+
+  /* repeated once per burst for the children */
+  if (!hipsens_address_equal(sender_address, tree->parent_address)
+      || !opera_central_has_child(tree) || chunk_index >= 32)
+    return;
+  if (burst_seq_num != central->forwarded_burst_seq_num) {
+    central->forwarded_burst_seq_num = burst_seq_num;
+    central->forwarded_chunk_set = 0;
+  }
+  hipsens_u32 chunk_mask = ((hipsens_u32)1) << chunk_index;
+  if ((central->forwarded_chunk_set & chunk_mask) == 0
+      && opera_central_enqueue(state, packet, message_size + 2))
+    central->forwarded_chunk_set |= chunk_mask;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int opera_central_generate_report(opera_state_t* state,
+					 buffer_t* buffer)
+{
+  opera_central_state_t* central = &state->central_state;
+  eond_state_t* eond_state = &state->eond_state;
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+
+  eostc_tree_t* tree = opera_central_find_tree
+    (state, central->report_root_address);
+  if (tree == NULL || tree->status != EOSTC_HasParent
+      || tree->serena_info->tree_seq_num != central->report_tree_seq_num
+      || state->serena_state.central_color != COLOR_NONE
+      || (state->serena_state.is_started
+	  && state->serena_state.color != COLOR_NONE)) {
+    /* the tree has changed, or the report has been received */
+    central->is_reporting = HIPSENS_FALSE;
+    return 0;
+  }
+  int max_address = (buffer->size - CENTRAL_REPORT_HEADER_SIZE)
+    / ADDRESS_SIZE;
+  if (max_address <= 0) {
+    STWARN("packet buffer too small\n");
+    return 0;
+  }
+
+  buffer_put_u8(buffer, HIPSENS_MSG_NEIGHBOR_REPORT);
+  int msg_size_pos = buffer->pos;
+  buffer_put_u8(buffer, 0); /* size, filled later */
+  int msg_content_start_pos = buffer->pos;
+  buffer_put_ADDRESS(buffer, my_address); /* sender */
+  buffer_put_ADDRESS(buffer, tree->parent_address); /* destination */
+  buffer_put_ADDRESS(buffer, tree->root_address);
+  buffer_put_u16(buffer, tree->serena_info->tree_seq_num);
+  buffer_put_ADDRESS(buffer, my_address); /* origin */
+  buffer_put_ADDRESS(buffer, tree->parent_address); /* parent of origin */
+  int flags_pos = buffer->pos;
+  buffer_put_u8(buffer, 0); /* flags, filled later */
+  buffer_put_u8(buffer, 0); /* nb. address, filled later */
+
+  int nb_address = 0;
+  int i = central->report_next_index;
+  for (; i<EOND_MAX_NEIGHBOR(eond_state); i++) {
+    eond_neighbor_t* neighbor = &eond_state->neighbor_table[i];
+    if (neighbor->state != EOND_Sym)
+      continue;
+    if (nb_address >= max_address)
+      break;
+    buffer_put_ADDRESS(buffer, neighbor->address);
+    nb_address ++;
+  }
+  central->report_next_index = i;
+  hipsens_u8 flags = 0;
+  if (i >= EOND_MAX_NEIGHBOR(eond_state)) {
+    /* repeated until a color is assigned (lost or dropped messages) */
+    flags |= CENTRAL_REPORT_FLAG_LAST;
+    central->report_next_index = 0;
+    central->next_report_time = base_state_time_after_delay_jitter
+      (state->base, state->config->eostc_config.stc_interval,
+       state->config->eostc_config.max_jitter_time);
+  }
+
+  if (buffer->status != HIPSENS_TRUE) {
+    WARN(state->base, "packet buffer too small\n");
+    return -1;
+  }
+  int result = buffer->pos;
+  buffer->pos = flags_pos;
+  buffer_put_u8(buffer, flags);
+  buffer_put_u8(buffer, nb_address);
+  buffer->pos = msg_size_pos;
+  buffer_put_u8(buffer, result - msg_content_start_pos);
+  buffer->pos = result;
+  return result;
+}
+
+static int opera_central_generate_assignment(opera_state_t* state,
+					     buffer_t* buffer)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+
+  if (buffer->size < CENTRAL_ASSIGNMENT_HEADER_SIZE
+      + CENTRAL_ASSIGNMENT_MAX_ENTRY * CENTRAL_ASSIGNMENT_ENTRY_SIZE) {
+    STWARN("packet buffer too small\n");
+    return 0;
+  }
+
+  int nb_colored = 0;
+  int i;
+  for (i=0; i<graph->nb_node; i++)
+    if (graph->node[i].color != COLOR_NONE)
+      nb_colored ++;
+  int nb_chunk = (nb_colored + CENTRAL_ASSIGNMENT_MAX_ENTRY - 1)
+    / CENTRAL_ASSIGNMENT_MAX_ENTRY;
+  if (graph->next_chunk_index == 0)
+    graph->burst_seq_num ++;
+
+  buffer_put_u8(buffer, HIPSENS_MSG_COLOR_ASSIGNMENT);
+  int msg_size_pos = buffer->pos;
+  buffer_put_u8(buffer, 0); /* size, filled later */
+  int msg_content_start_pos = buffer->pos;
+  buffer_put_ADDRESS(buffer, my_address); /* sender */
+  buffer_put_ADDRESS(buffer, my_address); /* root */
+  buffer_put_u16(buffer, graph->tree_seq_num);
+  buffer_put_u8(buffer, graph->burst_seq_num);
+  buffer_put_u8(buffer, graph->next_chunk_index);
+  buffer_put_u8(buffer, nb_chunk);
+  int first_entry = graph->next_chunk_index * CENTRAL_ASSIGNMENT_MAX_ENTRY;
+  int nb_entry = nb_colored - first_entry;
+  if (nb_entry > CENTRAL_ASSIGNMENT_MAX_ENTRY)
+    nb_entry = CENTRAL_ASSIGNMENT_MAX_ENTRY;
+  buffer_put_u8(buffer, nb_entry);
+
+  int entry_index = 0;
+  for (i=0; i<graph->nb_node; i++) {
+    opera_central_node_t* node = &graph->node[i];
+    if (node->color == COLOR_NONE)
+      continue;
+    if (entry_index >= first_entry && entry_index < first_entry + nb_entry) {
+      buffer_put_ADDRESS(buffer, node->address);
+      buffer_put_u8(buffer, node->color);
+    }
+    entry_index ++;
+  }
+
+  graph->next_chunk_index ++;
+  if (graph->next_chunk_index >= nb_chunk) {
+    graph->next_chunk_index = 0;
+    graph->next_burst_time = HIPSENS_TIME_ADD
+      (state->base->current_time, state->config->eostc_config.stc_interval);
+  }
+
+  if (buffer->status != HIPSENS_TRUE) {
+    WARN(state->base, "packet buffer too small\n");
+    return -1;
+  }
+  int result = buffer->pos;
+  buffer->pos = msg_size_pos;
+  buffer_put_u8(buffer, result - msg_content_start_pos);
+  buffer->pos = result;
+  return result;
+}
+
+static hipsens_bool opera_central_is_bursting(opera_state_t* state)
+{
+  opera_central_graph_t* graph = state->central_state.graph;
+  return graph != NULL && graph->is_computed && !state->has_set_color;
+}
+
+hipsens_time_t opera_central_get_next_time(opera_state_t* state)
+{
+  opera_central_state_t* central = &state->central_state;
+  hipsens_time_t result = undefined_time;
+  if (central->queue_count > 0)
+    return state->base->current_time;
+  if (central->is_reporting)
+    result = central->next_report_time;
+  if (opera_central_is_bursting(state))
+    hipsens_time_to_min(&result, central->graph->next_burst_time);
+  if (result != undefined_time && HIPSENS_TIME_COMPARE_NO_UNDEF
+      (result, <, state->base->current_time))
+    result = state->base->current_time; /* late: as soon as possible */
+  return result;
+}
+
+int opera_central_notify_wakeup(opera_state_t* state,
+				byte* packet, int max_packet_size)
+{
+  opera_central_state_t* central = &state->central_state;
+  if (packet == NULL)
+    return 0;
+
+  /* forwarded messages first */
+  while (central->queue_count > 0) {
+    int index = central->queue_head;
+    int message_size = central->queue_size[index];
+    central->queue_head = (central->queue_head + 1) % OPERA_CENTRAL_QUEUE_SIZE;
+    central->queue_count --;
+    if (message_size <= max_packet_size) {
+      memcpy(packet, central->queue[index], message_size);
+      return message_size;
+    }
+    STWARN("packet buffer too small, forwarded message dropped\n");
+  }
+
+  buffer_t buffer;
+  buffer_init(&buffer, packet, max_packet_size);
+  int result = 0;
+  if (central->is_reporting
+      && HIPSENS_TIME_COMPARE_LARGE_UNDEF
+      (central->next_report_time, <=, state->base->current_time))
+    result = opera_central_generate_report(state, &buffer);
+  else if (opera_central_is_bursting(state)
+	   && HIPSENS_TIME_COMPARE_LARGE_UNDEF
+	   (central->graph->next_burst_time, <=, state->base->current_time))
+    result = opera_central_generate_assignment(state, &buffer);
+  return (result > 0) ? result : 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#endif /* WITH_OPERA_CENTRAL_COLORING */
@@ -0,0 +1,162 @@
+/*---------------------------------------------------------------------------
+ *               OPERA - Centralized Coloring at the Tree Root
+ *---------------------------------------------------------------------------
+ * Author: agent
+ * Copyright 2026 agent.
+ *
+ * This file is part of the OPERA.
+ *
+ * The OPERA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * The OPERA is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+ * http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *---------------------------------------------------------------------------*/
+
+/**
+ * Centralized coloring: instead of the distributed rounds of SERENA,
+ * the colors are computed by the root of the colored tree (the CPAN):
+ *
+ * - when its subtree becomes stable, every node sends the list of its
+ *   symmetric neighbors to its parent in a Neighbor Report message ('R'),
+ *   the parents forward the reports towards the root ; the report is
+ *   repeated every `stc_interval' until the node gets its color
+ * - when it has the reports of all its descendants, the root computes a
+ *   distance-3 (or distance-2, see SERENA_CONFLICT_DISTANCE) coloring of
+ *   the reported graph, with the Jones-Plassmann rounds (in each round,
+ *   every uncolored node with the highest priority among the uncolored
+ *   nodes within the conflict distance takes the lowest free color ; the
+ *   nodes of one round are independent and could be colored in parallel)
+ *   and with the same priorities and constraints as SERENA
+ * - the colors are sent in Color Assignment messages ('A'), repeated by
+ *   the nodes with children, and repeated by the root every `stc_interval'
+ *   until the coloring is finished
+ * - SERENA still runs, but a node does not choose its color itself: it
+ *   takes the assigned color; Color messages are then used as usual for
+ *   the colors of the neighbors and the max color, hence the result is
+ *   given as with the distributed coloring (hipsens_api_set_color_info,
+ *   hipsens_api_set_nb_color).
+ *   If no color is assigned after `central_timeout' (lost messages, full
+ *   tables at the root...), the node falls back to the distributed coloring.
+ */
+
+#ifndef _HIPSENS_CENTRAL_COLORING_H
+#define _HIPSENS_CENTRAL_COLORING_H
+
+/*---------------------------------------------------------------------------*/
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+
+#define HIPSENS_MSG_NEIGHBOR_REPORT 'R'
+#define HIPSENS_MSG_COLOR_ASSIGNMENT 'A'
+
+#if MAX_CENTRAL_NODE >= 0xff
+#error "MAX_CENTRAL_NODE must be lower than 255"
+#endif
+
+#ifndef OPERA_CENTRAL_QUEUE_SIZE
+#define OPERA_CENTRAL_QUEUE_SIZE 8 /**< forwarded messages */
+#endif
+
+#define CENTRAL_NODE_NONE 0xffu
+
+/* header of the Color Assignment: type, size, sender, root, tree seq. num,
+   burst seq. num, chunk index, nb. chunk, nb. entry ; entry: address, color */
+#define CENTRAL_ASSIGNMENT_HEADER_SIZE (2 + 2*ADDRESS_SIZE + 2 + 4)
+#define CENTRAL_ASSIGNMENT_ENTRY_SIZE (ADDRESS_SIZE + 1)
+#define CENTRAL_ASSIGNMENT_MAX_ENTRY					\
+  ((MAX_PACKET_SIZE - CENTRAL_ASSIGNMENT_HEADER_SIZE)			\
+   / CENTRAL_ASSIGNMENT_ENTRY_SIZE)
+
+/** A node of the graph collected by the root */
+typedef struct s_opera_central_node_t {
+  address_t address;
+  address_t parent_address;
+  hipsens_u8 parent_index;  /**< set by the computation */
+  hipsens_u8 distance;      /**< used by the computation */
+  hipsens_u16 priority;     /**< set by the computation */
+  byte color;
+  hipsens_bool has_reported :1; /**< has sent the last part of its report */
+  hipsens_bool is_selected  :1; /**< used by the computation */
+  hipsens_u8 nb_neighbor;
+  hipsens_u8 neighbor[MAX_NEIGHBOR]; /**< indices in the node table */
+} opera_central_node_t;
+
+/** Root: the collected graph and its coloring (see opera_central_set_graph) */
+typedef struct s_opera_central_graph_t {
+  hipsens_bool is_collecting :1;
+  hipsens_bool is_overflow   :1; /**< a table was full: no central coloring */
+  hipsens_bool is_computed   :1;
+  hipsens_u16 tree_seq_num;
+  hipsens_u16 expected_nb_node;  /**< nodes of the tree, 0 if not yet known */
+  hipsens_u16 nb_reported;
+  hipsens_u16 nb_node;
+  opera_central_node_t node[MAX_CENTRAL_NODE];
+  hipsens_u8 nb_round;           /**< rounds of the last computation */
+  hipsens_u8 burst_seq_num;
+  hipsens_u8 next_chunk_index;   /**< in the current burst of assignments */
+  hipsens_time_t next_burst_time;
+} opera_central_graph_t;
+
+typedef struct s_opera_central_state_t {
+  opera_central_graph_t* graph; /**< NULL if the node cannot be the root */
+
+  /* every node: its own report and the forwarded messages */
+  hipsens_bool is_reporting :1; /**< until a color is assigned */
+  address_t report_root_address;
+  hipsens_u16 report_tree_seq_num;
+  hipsens_u16 report_next_index; /**< next entry of the EOND table */
+  hipsens_time_t next_report_time;
+  hipsens_u8 forwarded_burst_seq_num;
+  hipsens_u32 forwarded_chunk_set;
+  hipsens_u8 queue_head;
+  hipsens_u8 queue_count;
+  hipsens_u8 queue_size[OPERA_CENTRAL_QUEUE_SIZE];
+  byte queue[OPERA_CENTRAL_QUEUE_SIZE][MAX_PACKET_SIZE];
+} opera_central_state_t;
+
+struct s_opera_state_t;
+
+void opera_central_init(opera_central_state_t* central);
+
+/**
+ * Gives the memory of the collected graph to the node which can be the
+ * root of the colored tree (the CPAN): only that node needs it. Must be
+ * called once (the graph is kept by later re-initializations ; until
+ * then, the pointer is the NULL of the zeroed global opera_state_t).
+ * A root without graph lets SERENA color the tree.
+ */
+void opera_central_set_graph(struct s_opera_state_t* state,
+			     opera_central_graph_t* graph);
+
+/**
+ * Called when the colored tree `tree' becomes stable (on the root) or
+ * when the subtree of the node becomes stable (other nodes):
+ * starts the report of the neighbors, or the collection on the root.
+ */
+void opera_central_start(struct s_opera_state_t* state, eostc_tree_t* tree);
+
+void opera_central_process_report(struct s_opera_state_t* state,
+				  byte* packet, int max_packet_size);
+void opera_central_process_assignment(struct s_opera_state_t* state,
+				      byte* packet, int max_packet_size);
+
+/** time at which a message should be generated, undefined_time if none */
+hipsens_time_t opera_central_get_next_time(struct s_opera_state_t* state);
+int opera_central_notify_wakeup(struct s_opera_state_t* state,
+				byte* packet, int max_packet_size);
+
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+/*---------------------------------------------------------------------------*/
+
+#endif /* _HIPSENS_CENTRAL_COLORING_H */
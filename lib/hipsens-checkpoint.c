@@ -0,0 +1,608 @@
+/*---------------------------------------------------------------------------
+ *                  OPERA - Warm-Restart Checkpoint
+ *---------------------------------------------------------------------------
+ * Author: agent
+ * Copyright 2026 agent.
+ *
+ * This file is part of the OPERA.
+ *
+ * The OPERA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * The OPERA is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+ * http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *---------------------------------------------------------------------------*/
+
+#include "hipsens-all.h"
+
+#ifdef WITH_OPERA_CHECKPOINT
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Content of the sections (version 2), 'time' are 4 bytes (hipsens_time_t),
+  'addr' are ADDRESS_SIZE bytes:
+
+  'O' (opera):  flags(1) nb_color(1)
+  'H' (eond):   hello_seq_num(2) nb_neighbor(2) then for each neighbor:
+                  addr state(1) sym_time asym_time nb_1hop(1) energy_class(1)
+  'S' (eostc):  my_tree_index(2) nb_tree(2) then for each non-empty tree:
+                  index(2) status(1) root_addr stc_seq_num(2) parent_addr
+                  cost(2) validity_time received_vtime(1)
+                  is_serena(1) and, if is_serena:
+                    flags(1) state_bits(1) stability_time tree_seq_num(2)
+                    nb_child(2) then for each child:
+                      addr nb_descendant(2) status(1) validity_time
+  'C' (serena): state_bits(1) color_seq_num(2) color(1) root_addr
+                tree_seq_num(2) last_nb_color(1) final_node_color(1)
+                final_nb_neighbor_color(1) + list(1 each)
+                with WITH_OPERA_MULTI_SLOT: final_nb_node_color(1) + list
+                with WITH_OPERA_MULTI_CHANNEL: final_node_channel(1)
+                  + channel of each neighbor color(1 each)
+
+  The SERENA neighbor table and the priorities are not saved: they are
+  only needed during a coloring, which is restarted anyway by the root
+  when the topology changes.
+*/
+
+#define CHECKPOINT_CHECKSUM_SIZE 2
+
+#define buffer_put_TIME(buffer, time) \
+  buffer_put_u32((buffer), (hipsens_u32)(time))
+
+#define buffer_get_TIME(buffer) \
+  ((hipsens_time_t)buffer_get_u32(buffer))
+
+/* same helpers as hipsens-snapshot.c */
+static int checkpoint_begin_section(buffer_t* buffer, byte tag)
+{
+  buffer_put_u8(buffer, tag);
+  int size_pos = buffer->pos;
+  buffer_put_u16(buffer, 0); /* size, filled in checkpoint_end_section */
+  return size_pos;
+}
+
+static void checkpoint_end_section(buffer_t* buffer, int size_pos)
+{
+  if (buffer->status != HIPSENS_TRUE)
+    return;
+  int end_pos = buffer->pos;
+  buffer->pos = size_pos;
+  buffer_put_u16(buffer, end_pos - size_pos - 2);
+  buffer->pos = end_pos;
+}
+
+static void checkpoint_patch_u16(buffer_t* buffer, int pos, hipsens_u16 value)
+{
+  if (buffer->status != HIPSENS_TRUE)
+    return;
+  int end_pos = buffer->pos;
+  buffer->pos = pos;
+  buffer_put_u16(buffer, value);
+  buffer->pos = end_pos;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void checkpoint_put_opera(buffer_t* buffer, opera_state_t* state)
+{
+  int size_pos = checkpoint_begin_section(buffer,
+					  OPERA_CHECKPOINT_SECTION_OPERA);
+  buffer_put_u8(buffer, ( (state->is_colored_tree_root << 0)
+			  | (state->has_set_color << 1) ));
+  if (state->has_set_color) {
+    int nb_color = serena_get_nb_color(&state->serena_state);
+#ifdef WITH_OPERA_MULTI_CHANNEL
+    /* as given to the MAC */
+    nb_color = serena_get_nb_channel_slot(&state->serena_state, nb_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+    buffer_put_u8(buffer, nb_color);
+  } else buffer_put_u8(buffer, 0);
+  checkpoint_end_section(buffer, size_pos);
+}
+
+static void checkpoint_put_eond(buffer_t* buffer, eond_state_t* state)
+{
+  int size_pos = checkpoint_begin_section(buffer,
+					  OPERA_CHECKPOINT_SECTION_EOND);
+  buffer_put_u16(buffer, state->hello_seq_num);
+
+  int count_pos = buffer->pos;
+  int count = 0;
+  int i;
+  buffer_put_u16(buffer, 0); /* nb_neighbor, filled later */
+  for (i=0; i<EOND_MAX_NEIGHBOR(state); i++) {
+    eond_neighbor_t* neighbor = &(state->neighbor_table[i]);
+    if (neighbor->state == EOND_None)
+      continue;
+    buffer_put_ADDRESS(buffer, neighbor->address);
+    buffer_put_u8(buffer, neighbor->state);
+    buffer_put_TIME(buffer, neighbor->sym_time);
+    buffer_put_TIME(buffer, neighbor->asym_time);
+    buffer_put_u8(buffer, neighbor->nb_1hop);
+#ifdef WITH_ENERGY
+    buffer_put_u8(buffer, neighbor->energy_class);
+#else
+    buffer_put_u8(buffer, 0);
+#endif /* WITH_ENERGY */
+    count++;
+  }
+  checkpoint_patch_u16(buffer, count_pos, count);
+  checkpoint_end_section(buffer, size_pos);
+}
+
+static void checkpoint_put_serena_tree(buffer_t* buffer, eostc_state_t* state,
+				       eostc_serena_tree_t* serena_tree)
+{
+  buffer_put_u8(buffer, serena_tree->flags);
+  buffer_put_u8(buffer, ( (serena_tree->should_generate_tree_status << 0)
+			  | (serena_tree->limit_tree_status << 1)
+			  | (serena_tree->is_subtree_stable << 2)
+			  | (serena_tree->is_neighborhood_stable << 3)
+			  | (serena_tree->has_sent_stable << 4) ));
+  buffer_put_TIME(buffer, serena_tree->stability_time);
+  buffer_put_u16(buffer, serena_tree->tree_seq_num);
+
+  int count_pos = buffer->pos;
+  int count = 0;
+  int i;
+  buffer_put_u16(buffer, 0); /* nb_child, filled later */
+  for (i=0; i<EOSTC_MAX_CHILD(serena_tree); i++) {
+    eostc_child_t* child = &(serena_tree->child[i]);
+    if (child->status == Child_None)
+      continue;
+    buffer_put_ADDRESS(buffer, EOSTC_CHILD_ADDRESS(state, child));
+    buffer_put_u16(buffer, child->nb_descendant);
+    buffer_put_u8(buffer, child->status);
+    buffer_put_TIME(buffer, child->validity_time);
+    count++;
+  }
+  checkpoint_patch_u16(buffer, count_pos, count);
+}
+
+static void checkpoint_put_eostc(buffer_t* buffer, eostc_state_t* state)
+{
+  int size_pos = checkpoint_begin_section(buffer,
+					  OPERA_CHECKPOINT_SECTION_EOSTC);
+  if (state->my_tree != NULL)
+    buffer_put_u16(buffer, state->my_tree - state->tree);
+  else buffer_put_u16(buffer, 0xffffu);
+
+  int count_pos = buffer->pos;
+  int count = 0;
+  int i;
+  buffer_put_u16(buffer, 0); /* nb_tree, filled later */
+  for (i=0; i<EOSTC_MAX_TREE(state); i++) {
+    eostc_tree_t* tree = &(state->tree[i]);
+    if (tree->status == EOSTC_None)
+      continue;
+    buffer_put_u16(buffer, i);
+    buffer_put_u8(buffer, tree->status);
+    buffer_put_ADDRESS(buffer, tree->root_address);
+    buffer_put_u16(buffer, tree->stc_seq_num);
+    buffer_put_ADDRESS(buffer, tree->parent_address);
+    buffer_put_u16(buffer, tree->current_cost);
+    buffer_put_TIME(buffer, tree->validity_time);
+    buffer_put_u8(buffer, tree->received_vtime);
+    buffer_put_u8(buffer, IS_FOR_SERENA(*tree));
+    if (IS_FOR_SERENA(*tree))
+      checkpoint_put_serena_tree(buffer, state, tree->serena_info);
+    count++;
+  }
+  checkpoint_patch_u16(buffer, count_pos, count);
+  checkpoint_end_section(buffer, size_pos);
+}
+
+static void checkpoint_put_serena(buffer_t* buffer, serena_state_t* state)
+{
+  int size_pos = checkpoint_begin_section(buffer,
+					  OPERA_CHECKPOINT_SECTION_SERENA);
+  buffer_put_u8(buffer, ( (state->is_started << 0)
+			  | (state->is_finished << 1) ));
+  buffer_put_u16(buffer, state->color_seq_num);
+  buffer_put_u8(buffer, state->color);
+  buffer_put_ADDRESS(buffer, state->root_address);
+  buffer_put_u16(buffer, state->tree_seq_num);
+  buffer_put_u8(buffer, state->last_nb_color);
+  buffer_put_u8(buffer, state->final_node_color);
+  buffer_put_u8(buffer, state->final_nb_neighbor_color);
+  buffer_put_data(buffer, state->final_neighbor_color_list,
+		  state->final_nb_neighbor_color);
+#ifdef WITH_OPERA_MULTI_SLOT
+  buffer_put_u8(buffer, state->final_nb_node_color);
+  buffer_put_data(buffer, state->final_node_color_list,
+		  state->final_nb_node_color);
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  buffer_put_u8(buffer, state->final_node_channel);
+  buffer_put_data(buffer, state->final_neighbor_channel_list,
+		  state->final_nb_neighbor_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+  checkpoint_end_section(buffer, size_pos);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int opera_checkpoint_write(opera_state_t* state, byte* data, int max_size)
+{
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  buffer_t buffer;
+  buffer_init(&buffer, data, max_size);
+
+  /* --- header */
+  buffer_put_u8(&buffer, OPERA_CHECKPOINT_MAGIC_1);
+  buffer_put_u8(&buffer, OPERA_CHECKPOINT_MAGIC_2);
+  buffer_put_u8(&buffer, OPERA_CHECKPOINT_VERSION);
+  buffer_put_u8(&buffer, ADDRESS_SIZE);
+  int total_size_pos = buffer.pos;
+  buffer_put_u16(&buffer, 0); /* total size, filled later */
+  buffer_put_ADDRESS(&buffer, my_address);
+  buffer_put_TIME(&buffer, state->base_state.current_time);
+
+  /* --- sections */
+  checkpoint_put_opera(&buffer, state);
+  checkpoint_put_eond(&buffer, &state->eond_state);
+  checkpoint_put_eostc(&buffer, &state->eostc_state);
+  checkpoint_put_serena(&buffer, &state->serena_state);
+
+  int result = buffer.pos + CHECKPOINT_CHECKSUM_SIZE;
+  if (buffer.status != HIPSENS_TRUE || result > 0xffff)
+    return OPERA_CHECKPOINT_BAD_SIZE;
+  buffer.pos = total_size_pos;
+  buffer_put_u16(&buffer, result);
+  buffer.pos = result - CHECKPOINT_CHECKSUM_SIZE;
+  buffer_put_u16(&buffer, data_checksum(0, data, buffer.pos));
+  if (buffer.status != HIPSENS_TRUE)
+    return OPERA_CHECKPOINT_BAD_SIZE;
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/* converts a time of the checkpoint in a time of the restored node */
+static hipsens_time_t checkpoint_get_time(buffer_t* buffer,
+					  hipsens_time_t time_shift)
+{
+  hipsens_time_t time = buffer_get_TIME(buffer);
+  return (time == undefined_time) ? undefined_time : time + time_shift;
+}
+
+/* an undefined time never expires */
+#define CHECKPOINT_IS_EXPIRED(time, current_time) \
+  HIPSENS_TIME_COMPARE_LARGE_UNDEF(time, <=, current_time)
+
+/* the checkpoint_get_* functions only parse the section when
+   `is_applied' is false (see opera_checkpoint_restore) */
+
+static void checkpoint_skip(buffer_t* buffer, int size)
+{
+  if (buffer->pos + size <= buffer->size)
+    buffer->pos += size;
+  else buffer->status = ND_ERROR;
+}
+
+static void checkpoint_get_opera(buffer_t* buffer, opera_state_t* state,
+				 hipsens_bool is_applied)
+{
+  hipsens_u8 flags = buffer_get_u8(buffer);
+  hipsens_u8 nb_color = buffer_get_u8(buffer);
+  if (!is_applied || buffer->status != HIPSENS_TRUE)
+    return;
+  state->is_colored_tree_root = (flags >> 0) & 1;
+  state->has_set_color = ((flags >> 1) & 1) && nb_color > 0;
+  if (state->has_set_color)
+    hipsens_api_set_nb_color(state->base_state.opaque_extra_info, nb_color);
+}
+
+static void checkpoint_get_eond(buffer_t* buffer, eond_state_t* state,
+				hipsens_time_t time_shift, hipsens_bool is_applied)
+{
+  hipsens_time_t current_time = state->base->current_time;
+  hipsens_u16 hello_seq_num = buffer_get_u16(buffer);
+  if (is_applied)
+    state->hello_seq_num = hello_seq_num;
+
+  int count = buffer_get_u16(buffer);
+  int i, entry_index = 0;
+  for (i=0; i<count; i++) {
+    address_t address;
+    buffer_get_ADDRESS(buffer, address);
+    eond_neighbor_state_t neighbor_state = buffer_get_u8(buffer);
+    hipsens_time_t sym_time = checkpoint_get_time(buffer, time_shift);
+    hipsens_time_t asym_time = checkpoint_get_time(buffer, time_shift);
+    hipsens_u8 nb_1hop = buffer_get_u8(buffer);
+    hipsens_u8 energy_class = buffer_get_u8(buffer);
+
+    if (!is_applied || buffer->status != HIPSENS_TRUE
+	|| entry_index >= EOND_MAX_NEIGHBOR(state)
+	|| CHECKPOINT_IS_EXPIRED(asym_time, current_time))
+      continue;
+    eond_neighbor_t* neighbor = &(state->neighbor_table[entry_index]);
+    entry_index++;
+    hipsens_address_copy(neighbor->address, address);
+    neighbor->state = neighbor_state; /* checked by eond_check_expiration */
+    neighbor->sym_time = sym_time;
+    neighbor->asym_time = asym_time;
+    neighbor->nb_1hop = nb_1hop;
+#ifdef WITH_ENERGY
+    neighbor->energy_class = energy_class;
+#else
+    (void)energy_class;
+#endif /* WITH_ENERGY */
+#ifdef WITH_STAT
+    neighbor->recv_count = 0;
+#endif
+#ifdef WITH_INPACKET_LINK_STAT
+    neighbor->link_stat = 0;
+#endif /* WITH_INPACKET_LINK_STAT */
+  }
+  if (is_applied)
+    state->has_neighborhood_changed = HIPSENS_TRUE;
+}
+
+/* `serena_tree' may be NULL (the content is then only parsed) */
+static void checkpoint_get_serena_tree(buffer_t* buffer, eostc_state_t* state,
+				       eostc_serena_tree_t* serena_tree,
+				       hipsens_time_t time_shift)
+{
+  hipsens_time_t current_time = state->base->current_time;
+  hipsens_u8 flags = buffer_get_u8(buffer);
+  hipsens_u8 bits = buffer_get_u8(buffer);
+  hipsens_time_t stability_time = checkpoint_get_time(buffer, time_shift);
+  hipsens_u16 tree_seq_num = buffer_get_u16(buffer);
+  if (serena_tree != NULL) {
+    clear_serena_tree(serena_tree);
+    serena_tree->flags = flags;
+    serena_tree->should_generate_tree_status = (bits >> 0) & 1;
+    serena_tree->limit_tree_status = (bits >> 1) & 1;
+    serena_tree->is_subtree_stable = (bits >> 2) & 1;
+    serena_tree->is_neighborhood_stable = (bits >> 3) & 1;
+    serena_tree->has_sent_stable = (bits >> 4) & 1;
+    serena_tree->stability_time = stability_time;
+    serena_tree->tree_seq_num = tree_seq_num;
+  }
+
+  int count = buffer_get_u16(buffer);
+  int i, entry_index = 0;
+  for (i=0; i<count; i++) {
+    address_t address;
+    buffer_get_ADDRESS(buffer, address);
+    hipsens_u16 nb_descendant = buffer_get_u16(buffer);
+    child_status_t status = buffer_get_u8(buffer);
+    hipsens_time_t validity_time = checkpoint_get_time(buffer, time_shift);
+    if (serena_tree == NULL || buffer->status != HIPSENS_TRUE
+	|| entry_index >= EOSTC_MAX_CHILD(serena_tree)
+	|| CHECKPOINT_IS_EXPIRED(validity_time, current_time))
+      continue;
+    /* the children are identified by their EOND entry (restored before) */
+    neighbor_id_t neighbor_id = eond_find_neighbor_id(state->eond_state,
+						      address);
+    if (neighbor_id == NEIGHBOR_ID_NONE)
+      continue;
+    eostc_child_t* child = &(serena_tree->child[entry_index]);
+    entry_index++;
+    child->neighbor_id = neighbor_id;
+    child->nb_descendant = nb_descendant;
+    child->status = status;
+    child->validity_time = validity_time;
+  }
+}
+
+static void checkpoint_get_eostc(buffer_t* buffer, eostc_state_t* state,
+				 hipsens_time_t time_shift, hipsens_bool is_applied)
+{
+  hipsens_time_t current_time = state->base->current_time;
+  int my_tree_index = buffer_get_u16(buffer);
+
+  int count = buffer_get_u16(buffer);
+  int i;
+  for (i=0; i<count && buffer->status == HIPSENS_TRUE; i++) {
+    int index = buffer_get_u16(buffer);
+    tree_status_t status = buffer_get_u8(buffer);
+    eostc_tree_t tree;
+    buffer_get_ADDRESS(buffer, tree.root_address);
+    tree.stc_seq_num = buffer_get_u16(buffer);
+    buffer_get_ADDRESS(buffer, tree.parent_address);
+    tree.current_cost = buffer_get_u16(buffer);
+    tree.validity_time = checkpoint_get_time(buffer, time_shift);
+    tree.received_vtime = buffer_get_u8(buffer);
+    hipsens_bool is_for_serena = buffer_get_u8(buffer);
+
+    /* the serena trees are the first ones of the table (same capacity
+       is expected, otherwise the tree is skipped) */
+    hipsens_bool is_usable =
+      (is_applied && index < EOSTC_MAX_TREE(state)
+       && IS_FOR_SERENA(state->tree[index]) == is_for_serena
+       && (status == EOSTC_IsRoot
+	   || (status == EOSTC_HasParent
+	       && !CHECKPOINT_IS_EXPIRED(tree.validity_time, current_time)
+	       && eond_find_neighbor_id(state->eond_state, tree.parent_address)
+	       != NEIGHBOR_ID_NONE)));
+
+    if (is_for_serena)
+      checkpoint_get_serena_tree
+	(buffer, state, is_usable ? state->tree[index].serena_info : NULL,
+	 time_shift);
+    if (!is_usable || buffer->status != HIPSENS_TRUE)
+      continue;
+
+    eostc_tree_t* restored_tree = &state->tree[index];
+    restored_tree->status = status;
+    hipsens_address_copy(restored_tree->root_address, tree.root_address);
+    restored_tree->stc_seq_num = tree.stc_seq_num;
+    hipsens_address_copy(restored_tree->parent_address, tree.parent_address);
+    restored_tree->current_cost = tree.current_cost;
+    restored_tree->validity_time = tree.validity_time;
+    restored_tree->received_vtime = tree.received_vtime;
+    restored_tree->ttl_if_generate = 0; /* no STC repetition */
+
+    if (index == my_tree_index && status == EOSTC_IsRoot) {
+      state->my_tree = restored_tree;
+      state->next_msg_stc_time = current_time; /* announce it again */
+    }
+  }
+}
+
+static void checkpoint_get_serena(buffer_t* buffer, serena_state_t* state,
+				  hipsens_bool is_applied)
+{
+  if (!is_applied) {
+    checkpoint_skip(buffer, 1+2+1+ADDRESS_SIZE+2+1+1);
+    int nb_neighbor_color = buffer_get_u8(buffer);
+    if (nb_neighbor_color > SERENA_MAX_NEIGHBOR_COLOR(state)) {
+      STWARN("checkpoint: too many neighbor colors (%d)\n", nb_neighbor_color);
+      buffer->status = ND_ERROR;
+      return;
+    }
+    checkpoint_skip(buffer, nb_neighbor_color);
+#ifdef WITH_OPERA_MULTI_SLOT
+    int nb_node_color = buffer_get_u8(buffer);
+    if (nb_node_color > MAX_NODE_COLOR) {
+      STWARN("checkpoint: too many node colors (%d)\n", nb_node_color);
+      buffer->status = ND_ERROR;
+      return;
+    }
+    checkpoint_skip(buffer, nb_node_color);
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+    checkpoint_skip(buffer, 1+nb_neighbor_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+    return;
+  }
+
+  /* the section was checked by the parsing pass */
+  hipsens_u8 bits = buffer_get_u8(buffer);
+  state->is_started = (bits >> 0) & 1;
+  state->is_finished = (bits >> 1) & 1;
+  state->color_seq_num = buffer_get_u16(buffer);
+  state->color = buffer_get_u8(buffer);
+  buffer_get_ADDRESS(buffer, state->root_address);
+  state->tree_seq_num = buffer_get_u16(buffer);
+  state->last_nb_color = buffer_get_u8(buffer);
+  state->final_node_color = buffer_get_u8(buffer);
+
+  int nb_neighbor_color = buffer_get_u8(buffer);
+  buffer_get_data(buffer, state->final_neighbor_color_list,
+		  nb_neighbor_color);
+  state->final_nb_neighbor_color = nb_neighbor_color;
+#ifdef WITH_OPERA_MULTI_SLOT
+  int nb_node_color = buffer_get_u8(buffer);
+  buffer_get_data(buffer, state->final_node_color_list, nb_node_color);
+  state->final_nb_node_color = nb_node_color;
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  state->final_node_channel = buffer_get_u8(buffer);
+  buffer_get_data(buffer, state->final_neighbor_channel_list,
+		  nb_neighbor_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+  if (state->is_started && !state->is_finished) {
+    /* interrupted coloring: wait for the next one */
+    state->is_started = HIPSENS_FALSE;
+    state->final_nb_neighbor_color = 0;
+  }
+}
+
+/* reads the sections of `buffer' from its position (which is kept),
+   EOND being restored before EOSTC */
+static int checkpoint_get_sections(opera_state_t* state, buffer_t* buffer,
+				   int end_pos, hipsens_time_t time_shift,
+				   hipsens_bool is_applied)
+{
+  int pos = buffer->pos;
+  while (pos < end_pos) {
+    buffer_t section_buffer;
+    buffer_init(&section_buffer, buffer->data, end_pos);
+    section_buffer.pos = pos;
+    byte tag = buffer_get_u8(&section_buffer);
+    int section_size = buffer_get_u16(&section_buffer);
+    int section_end = section_buffer.pos + section_size;
+    if (section_buffer.status != HIPSENS_TRUE || section_end > end_pos)
+      return OPERA_CHECKPOINT_BAD_FORMAT;
+    section_buffer.size = section_end;
+    if (tag == OPERA_CHECKPOINT_SECTION_OPERA)
+      checkpoint_get_opera(&section_buffer, state, is_applied);
+    else if (tag == OPERA_CHECKPOINT_SECTION_EOND)
+      checkpoint_get_eond(&section_buffer, &state->eond_state, time_shift,
+			  is_applied);
+    else if (tag == OPERA_CHECKPOINT_SECTION_EOSTC)
+      checkpoint_get_eostc(&section_buffer, &state->eostc_state, time_shift,
+			   is_applied);
+    else if (tag == OPERA_CHECKPOINT_SECTION_SERENA)
+      checkpoint_get_serena(&section_buffer, &state->serena_state,
+			    is_applied);
+    else section_buffer.pos = section_end; /* unknown sections are skipped */
+    if (section_buffer.status != HIPSENS_TRUE
+	|| section_buffer.pos != section_end) {
+      STWARN("checkpoint: bad section '%c'\n", tag);
+      return OPERA_CHECKPOINT_BAD_FORMAT;
+    }
+    pos = section_end;
+  }
+  return 0;
+}
+
+void opera_update_wakeup_condition(opera_state_t* state);
+
+int opera_checkpoint_restore(opera_state_t* state, byte* data, int size,
+			     hipsens_time_t age, hipsens_time_t max_age)
+{
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  buffer_t buffer;
+  buffer_init(&buffer, data, size);
+
+  /* --- header */
+  hipsens_u8 magic_1 = buffer_get_u8(&buffer);
+  hipsens_u8 magic_2 = buffer_get_u8(&buffer);
+  hipsens_u8 version = buffer_get_u8(&buffer);
+  hipsens_u8 address_size = buffer_get_u8(&buffer);
+  int total_size = buffer_get_u16(&buffer);
+  address_t address;
+  buffer_get_ADDRESS(&buffer, address);
+  hipsens_time_t checkpoint_time = buffer_get_TIME(&buffer);
+
+  if (buffer.status != HIPSENS_TRUE || total_size > size)
+    return OPERA_CHECKPOINT_BAD_SIZE;
+  if (magic_1 != OPERA_CHECKPOINT_MAGIC_1
+      || magic_2 != OPERA_CHECKPOINT_MAGIC_2
+      || version != OPERA_CHECKPOINT_VERSION || address_size != ADDRESS_SIZE
+      || total_size < buffer.pos + CHECKPOINT_CHECKSUM_SIZE)
+    return OPERA_CHECKPOINT_BAD_FORMAT;
+  int end_pos = total_size - CHECKPOINT_CHECKSUM_SIZE;
+  if (data_checksum(0, data, end_pos)
+      != ((data[end_pos] << 8) | data[end_pos+1]))
+    return OPERA_CHECKPOINT_BAD_FORMAT;
+  if (!hipsens_address_equal(address, my_address))
+    return OPERA_CHECKPOINT_BAD_ADDRESS;
+  if (age < 0 || age > max_age)
+    return OPERA_CHECKPOINT_TOO_OLD;
+
+  /* time of the checkpoint => time of the node */
+  hipsens_time_t time_shift =
+    state->base_state.current_time - age - checkpoint_time;
+  buffer.size = end_pos;
+
+  /* --- sections: all of them are parsed before the state is modified */
+  int status = checkpoint_get_sections(state, &buffer, end_pos, time_shift,
+				       HIPSENS_FALSE);
+  if (status < 0)
+    return status;
+  checkpoint_get_sections(state, &buffer, end_pos, time_shift, HIPSENS_TRUE);
+
+  /* neighbors which are no longer symmetric are removed from the trees */
+  eond_check_expiration(&state->eond_state);
+  opera_update_wakeup_condition(state);
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#endif /* WITH_OPERA_CHECKPOINT */
@@ -0,0 +1,100 @@
+/*---------------------------------------------------------------------------
+ *                  OPERA - Warm-Restart Checkpoint
+ *---------------------------------------------------------------------------
+ * Author: agent
+ * Copyright 2026 agent.
+ *
+ * This file is part of the OPERA.
+ *
+ * The OPERA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * The OPERA is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+ * http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *---------------------------------------------------------------------------*/
+
+/**
+ * Checkpoint of the stable parts of an opera_state_t (neighbor table,
+ * tree table, final colors, sequence numbers), to be stored in flash
+ * or in a file, and restored after a reboot or a reset, so that the
+ * node does not restart the neighbor discovery, tree construction and
+ * coloring from scratch.
+ *
+ * Layout (all integers in network order, as in hipsens-snapshot.h):
+ *
+ *  +------+------+---------+----------+---------------+-----------+------
+ *  | 'O'  | 'K'  | version | addr.size| total size(2) | address   | time(4)
+ *  +------+------+---------+----------+---------------+-----------+------
+ *  followed by sections (tag, size(2), content) and a checksum(2)
+ *  (CRC-16, data_checksum, of all the preceding bytes).
+ *
+ * The time is the current_time when the checkpoint was written,
+ * all the times of the checkpoint are shifted on restore.
+ *
+ * Typical use:
+ *   opera_init(...); opera_start(...);
+ *   opera_checkpoint_restore(..., age, max_age);  (before any event)
+ */
+
+#ifndef _HIPSENS_CHECKPOINT_H
+#define _HIPSENS_CHECKPOINT_H
+
+/*---------------------------------------------------------------------------*/
+
+#ifdef WITH_OPERA_CHECKPOINT
+
+#ifdef WITH_NEIGH_OPT
+#error "WITH_OPERA_CHECKPOINT is incompatible with WITH_NEIGH_OPT"
+#endif
+
+#define OPERA_CHECKPOINT_MAGIC_1 'O'
+#define OPERA_CHECKPOINT_MAGIC_2 'K'
+#define OPERA_CHECKPOINT_VERSION 3
+
+/* section tags */
+#define OPERA_CHECKPOINT_SECTION_OPERA  'O'
+#define OPERA_CHECKPOINT_SECTION_EOND   HIPSENS_MSG_HELLO
+#define OPERA_CHECKPOINT_SECTION_EOSTC  HIPSENS_MSG_STC
+#define OPERA_CHECKPOINT_SECTION_SERENA HIPSENS_MSG_COLOR
+
+/* error codes (returned as negative values) */
+#define OPERA_CHECKPOINT_BAD_SIZE    (-1)
+#define OPERA_CHECKPOINT_BAD_FORMAT  (-2) /**< magic, version, checksum... */
+#define OPERA_CHECKPOINT_BAD_ADDRESS (-3) /**< written by another node */
+#define OPERA_CHECKPOINT_TOO_OLD     (-4)
+
+/**
+ * Write a checkpoint of `state' in `data'.
+ * Returns the size of the checkpoint, or OPERA_CHECKPOINT_BAD_SIZE if
+ * `max_size' was too small.
+ */
+int opera_checkpoint_write(opera_state_t* state, byte* data, int max_size);
+
+/**
+ * Restore a checkpoint written by `opera_checkpoint_write' in `state',
+ * which must have just been started (opera_start).
+ * - `age' is the number of cycles elapsed since the checkpoint was written
+ *   (as estimated by the caller, for instance from a real-time clock)
+ * - the checkpoint is rejected if `age' > `max_age'
+ * Entries which would have expired during `age' are not restored.
+ * Returns 0 or one of the OPERA_CHECKPOINT_* error codes ; the header,
+ * the checksum, the age and the content of all the sections are checked
+ * before the state is modified, so that it is unchanged on error.
+ */
+int opera_checkpoint_restore(opera_state_t* state, byte* data, int size,
+			     hipsens_time_t age, hipsens_time_t max_age);
+
+#endif /* WITH_OPERA_CHECKPOINT */
+
+/*---------------------------------------------------------------------------*/
+
+#endif /* _HIPSENS_CHECKPOINT_H */
@@ -70,6 +70,134 @@
 //-- WITH_SIMUL_ADDR
 // when defined the address is the address of a simulation
 
+//-- WITH_OPERA_SNAPSHOT
+// when defined, opera_snapshot_write (hipsens-snapshot.c) is compiled in:
+// it writes the state in a compact binary format (see tools/OperaSnapshot.py)
+
+//-- WITH_OPERA_TRACE
+// when defined, STTRACE(...) records fixed-size binary events in a ring
+// in base_state_t (OPERA_TRACE_SIZE entries), which can be read with
+// base_state_trace_dump or the serial command OPERA_GET_TRACE and decoded
+// with tools/OperaTrace.py
+
+//-- WITH_OPERA_METRICS
+// when defined, STMETRIC_INC(...) maintains 32-bit counters (opera_metric_t)
+// in base_state_t: messages generated/parsed per type, bytes sent, parse
+// errors, full tables, parent changes...; they are read with
+// base_state_get_metric or the serial command OPERA_GET_METRICS
+
+//-- WITH_OPERA_PROFILE
+// when defined, the durations of opera_event_new_cycle/wakeup_with_buffer/
+// packet_received and of each EOND/EOSTC/SERENA step are measured with
+// OPERA_PROFILE_CLOCK() (to be defined for embedded targets; microseconds
+// from clock_gettime otherwise) and stored as log2 histograms, read with
+// base_state_get_profile or the serial command OPERA_GET_PROFILE
+
+//-- WITH_OPERA_ARENA
+// when defined, the tables of EOND, EOSTC and SERENA are not arrays sized
+// by MAX_NEIGHBOR/MAX_STC_TREE/MAX_STC_SERENA_TREE but are carved from
+// one contiguous arena with capacities given at run-time
+// (opera_direct_init_with_capacity, opera_set_arena) ; the MAX_* values
+// are then only the defaults. Incompatible with WITH_NEIGH_OPT.
+
+//-- WITH_OPERA_TX_SCHEDULER
+// when defined, the message generated in an offered buffer is not chosen
+// in the fixed order EOND, EOSTC, SERENA but by class priority (Hello,
+// STC, Tree Status, Color) with one token bucket per class
+// (opera_config_t.tx_class_config, or the serial commands
+// OPERA_SET_TX_CLASS/OPERA_GET_TX_CLASS)
+
+//-- WITH_OPERA_CHECKPOINT
+// when defined, opera_checkpoint_write/opera_checkpoint_restore
+// (hipsens-checkpoint.c) save and restore the neighbor table, the tree
+// table, the final colors and the sequence numbers, for warm restarts.
+// Incompatible with WITH_NEIGH_OPT.
+
+//-- WITH_OPERA_CENTRAL_COLORING
+// when defined, the colors can be computed by the root of the colored tree
+// from the neighbor lists reported by all the nodes, and sent back to them
+// (hipsens-central-coloring.c, serena_config_t.central_coloring) ; SERENA
+// then only disseminates the colors (and is the fallback). Only the root
+// needs the table of the graph (opera_central_set_graph).
+
+//-- WITH_OPERA_COLOR_COMPACTION
+// when defined, the Color messages also carry the colors used in the subtree
+// of the sender, and the root announces the colors used in the whole tree ;
+// the colors given to the MAC (nb. colors, node and neighbor colors) are then
+// renumbered without the unused colors, which shortens the cycle. As for
+// WITH_OPERA_SLOT_ORDER, the root finishes the coloring only once every
+// node confirmed the used colors.
+
+//-- WITH_OPERA_LOCAL_RECOLORING
+// when defined, a topology change after the coloring does not restart it:
+// the colored nodes keep their colors, and those which see a change in
+// their 3-hop neighborhood (new neighbor, new colors at 1 or 2 hops) send
+// Color messages again during serena_config_t.repair_duration, so that
+// only the new nodes are colored ; the nb. colors is updated only when
+// the max color grows. Incompatible with WITH_OPERA_COLOR_COMPACTION.
+
+//-- WITH_OPERA_SLOT_ORDER
+// when defined, the root announces the nb. colors of the tree in the Color
+// messages and, with serena_config_t.slot_order = Slot_order_children_first,
+// the colors given to the MAC are reversed: as a child has a greater color
+// than its parent, its slot is then before the slot of its parent, and a
+// packet can reach the root in one cycle (convergecast). The root repeats
+// the nb. colors in its Color messages, and finishes the coloring only once
+// every node confirmed it (a flag in the Color messages of its subtree,
+// set when the whole subtree has the information of the tree). The Color
+// messages also carry the latency of the subtree (opera_get_sink_latency).
+// Incompatible with WITH_OPERA_LOCAL_RECOLORING.
+
+//-- WITH_OPERA_MULTI_SLOT
+// when defined, a node can take several colors (slots) when it colors
+// itself: serena_config_t.nb_slot, or one per nb_descendant_per_slot nodes
+// of its subtree (itself included), at most MAX_NODE_COLOR. The other
+// colors are the lowest free colors above the color of the node; they
+// are sent in the Color messages and avoided at 3 hops as the color.
+// They are given by hipsens_api_set_node_color_list.
+// Incompatible with WITH_OPERA_CENTRAL_COLORING. Simulation only
+// (WITH_SIMUL): MaCARI has one slot per node.
+
+//-- WITH_OPERA_MULTI_CHANNEL
+// when defined, a color is a (slot, channel) pair: color = slot *
+// serena_config_t.nb_channel + channel. Only nodes at 3 hops may share a
+// slot: a node avoids the whole slots of its 1-hop and 2-hop colors, and
+// only the 3-hop colors themselves. The MAC is given slots (as colors,
+// nb_color is the number of slots) and the channels through
+// hipsens_api_set_channel_info. The value of nb_channel must be the same
+// on all the nodes. Incompatible with WITH_OPERA_CENTRAL_COLORING,
+// WITH_OPERA_COLOR_COMPACTION and WITH_OPERA_MULTI_SLOT. Simulation only
+// (WITH_SIMUL): MaCARI sends on one channel.
+
+//-- WITH_OPERA_CONFLICT_DISTANCE
+// when defined, serena_config_t.conflict_distance selects distance-3
+// colorings (the default) or distance-2 colorings, for MAC modes which
+// only need different colors at 1 and 2 hops: the Color messages then
+// have neither Max2Prio2 nor Bitmap2, and the 3-hop colors and
+// priorities are not used (with WITH_OPERA_MULTI_CHANNEL, only the slots
+// of the 1-hop colors are blocked). The value must be the same on all the
+// nodes: it is sent in the Color messages, and a node ignores the Color
+// messages with another value.
+
+//-- WITH_OPERA_COLOR_SUPPRESSION
+// when defined, a node does not send a Color message whose content (but
+// the sequence number) is the same as the one of the last message sent,
+// unless a neighbor misses its information (a new neighbor, or one whose
+// Color message lacks its color or Max2Prio1). After
+// serena_config_t.max_suppressed_color skipped messages in a row, one is
+// sent anyway, for the losses (0: never skip).
+
+//-- WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+// when defined, the interval between the Color messages is not fixed:
+// it is serena_config_t.min_color_interval while the content of the
+// messages changes or when a received Color message changes the tables
+// (Max2Prio, bitmaps), and doubles up to max_color_interval while they
+// are stable ; msg_color_interval is only the first interval. By default
+// the bounds are msg_color_interval and 4*msg_color_interval (a node then
+// never sends more often than with the fixed interval), and
+// opera_config_apply derives them again when only msg_color_interval
+// changes.
+
 /*---------------------------------------------------------------------------*/
 
 // XXX: not used now
@@ -117,6 +245,20 @@
 #define NB_COLOR_MAX 128
 #endif
 
+//-- MAX_FILTER_ADDRESS
+// the maximum number of addresses of the address filter of OPERA
+// (a few hundreds can be used to confine test networks)
+#ifndef MAX_FILTER_ADDRESS
+#define MAX_FILTER_ADDRESS 3
+#endif
+
+//-- MAX_CENTRAL_NODE
+// the maximum number of nodes of the graph collected by the root for
+// the centralized coloring (WITH_OPERA_CENTRAL_COLORING), at most 254
+#ifndef MAX_CENTRAL_NODE
+#define MAX_CENTRAL_NODE 64
+#endif
+
 #ifdef WITH_LINK_STAT
 #ifndef LINK_STAT_LOG_SIZE
 #define LINK_STAT_LOG_SIZE 80 
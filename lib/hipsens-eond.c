@@ -84,6 +84,7 @@ void eond_config_init_default(eond_config_t* config)
   config->neigh_hold_time = SEC_TO_HIPSENS_TIME(DEFAULT_NEIGH_HOLD_TIME_SEC);
   config->max_jitter_time = MILLISEC_TO_HIPSENS_TIME(DEFAULT_JITTER_MILLISEC);
 #endif
+  config->eviction_policy = EOND_Eviction_None;
 }
 
 void eond_state_reset(eond_state_t* state)
@@ -110,6 +111,7 @@ void eond_state_init(eond_state_t* state, base_state_t* base_state,
   STLOGA(DBGnd, "eond-init\n");
   state->observer_func = NULL;
   state->observer_data = NULL;
+  state->protect_func = NULL;
 
 #ifdef WITH_NEIGH_OPT
   state->current_max_neighbor = 0;
@@ -230,6 +232,77 @@ eond_neighbor_t* eond_find_neighbor_by_address(eond_state_t*state,
   return NULL;
 }
 
+neighbor_id_t eond_find_neighbor_id(eond_state_t* state, address_t address)
+{
+  eond_neighbor_t* neighbor = eond_find_neighbor_by_address(state, address);
+  if (neighbor == NULL)
+    return NEIGHBOR_ID_NONE;
+  return EOND_NEIGHBOR_ID(state, neighbor);
+}
+
+/* returns the index of the entry to replace by a new neighbor received
+   with `power' when the table is full, or -1 (see eond_eviction_policy_t) */
+static int eond_find_evicted_entry(eond_state_t* state, int max_neighbor,
+				   hipsens_u8 power)
+{
+  int i, result = -1;
+  eond_eviction_policy_t policy = state->config->eviction_policy;
+#ifndef WITH_STAT
+  UNUSED(power);
+  if (policy == EOND_Eviction_Weakest)
+    policy = EOND_Eviction_OldestAsym;
+#endif
+  if (policy == EOND_Eviction_None)
+    return -1;
+
+  for (i=0; i<max_neighbor; i++) {
+    eond_neighbor_t* neighbor = &(state->neighbor_table[i]);
+    if (neighbor->state == EOND_None)
+      continue;
+    if (policy == EOND_Eviction_OldestAsym && neighbor->state != EOND_Asym)
+      continue;
+    if (state->protect_func != NULL 
+	&& state->protect_func(state->observer_data, neighbor->address, i))
+      continue;
+
+#ifdef WITH_STAT
+    if (policy == EOND_Eviction_Weakest) {
+      if (neighbor->last_power >= power)
+	continue;
+      if (result < 0)
+	result = i;
+      else {
+	eond_neighbor_t* best = &(state->neighbor_table[result]);
+	/* lowest power first, asymmetric first for the same power */
+	if (neighbor->last_power < best->last_power
+	    || (neighbor->last_power == best->last_power
+		&& neighbor->state < best->state))
+	  result = i;
+      }
+      continue;
+    }
+#endif /* WITH_STAT */
+
+    if (result < 0 
+	|| HIPSENS_TIME_COMPARE_NO_UNDEF
+	(neighbor->asym_time, <, state->neighbor_table[result].asym_time))
+      result = i;
+  }
+  return result;
+}
+
+/* removes a neighbor entry, as if it had expired */
+static void eond_evict_entry(eond_state_t* state, int entry_index)
+{
+  eond_neighbor_t* neighbor = &(state->neighbor_table[entry_index]);
+  STLOG(DBGnd, " evicted-entry=%d", entry_index);
+  if (state->observer_func != NULL)
+    state->observer_func(state->observer_data, neighbor->address,
+			 neighbor->state, EOND_None, entry_index);
+  neighbor->state = EOND_None;
+  state->has_neighborhood_changed = HIPSENS_TRUE;
+}
+
 static void eond_process_hello_update_neighbor
 (eond_state_t* state, address_t neighbor_address, hipsens_u8 power, 
  hipsens_u16 seq_num, hipsens_time_t validity_time,
@@ -283,12 +356,21 @@ static void eond_process_hello_update_neighbor
       return;
     }
 
+    if (free_entry_index < 0) {
+      free_entry_index = eond_find_evicted_entry(state, max_neighbor, power);
+      if (free_entry_index >= 0)
+	eond_evict_entry(state, free_entry_index);
+    }
+
     if (free_entry_index < 0) {
       /* no room left in neighbor table, can't add new neighbor */
 #ifndef IS_EMBEDDED
       STWARN("neighbor table full [%d]\n",MAX_NEIGHBOR);
 #endif
       STLOG(DBGnd," neighbor-table-full\n");
+      STMETRIC_INC(OPERA_METRIC_NEIGHBOR_TABLE_FULL);
+      STTRACE(OPERA_TRACE_EOND_NEIGHBOR_TABLE_FULL,
+	      TRACE_ADDRESS(neighbor_address), power, 0);
       return;
     }
 
@@ -300,6 +382,8 @@ static void eond_process_hello_update_neighbor
     }
 #endif
     STLOG(DBGnd, " new-entry=%d", entry_index);
+    STTRACE(OPERA_TRACE_EOND_NEW_NEIGHBOR, TRACE_ADDRESS(neighbor_address),
+	    entry_index, power);
     neighbor = &(state->neighbor_table[entry_index]);
     hipsens_address_copy(neighbor->address, neighbor_address);
     neighbor->sym_time = HIPSENS_TIME_EXPIRED(current_time);
@@ -362,6 +446,8 @@ static void eond_process_hello_update_neighbor
 #endif
   if (neighbor->state != old_state) {
     STLOG(DBGnd, " state-changed:%d->%d\n", old_state, neighbor->state);
+    STTRACE(OPERA_TRACE_EOND_NEIGHBOR_STATE_CHANGE,
+	    TRACE_ADDRESS(neighbor_address), old_state, neighbor->state);
     if (state->observer_func != NULL)
       state->observer_func(state->observer_data, neighbor->address,
 			   old_state, neighbor->state, entry_index);
@@ -387,11 +473,13 @@ int eond_process_hello_message(eond_state_t* state,
 
   if (message_type != HIPSENS_MSG_HELLO) {
     STWARN("bad message type, hello expected, type=%d\n", message_type);
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return -1;
   }
   if (message_size > buffer.size - buffer.pos) {
     STWARN("bad message size, buffer remain.=%d, msg size=%d\n", 
 	   buffer.size-buffer.pos, message_size);
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return -1;
   }
   int result = buffer.pos + message_size;
@@ -402,6 +490,8 @@ int eond_process_hello_message(eond_state_t* state,
   hipsens_u16 seq_num = buffer_get_u16(&buffer);
   hipsens_time_t validity_time = vtime_to_hipsens_time(buffer_get_u8(&buffer));
   hipsens_u8 energy_class = buffer_get_u8(&buffer);
+  STTRACE(OPERA_TRACE_EOND_HELLO_RECEIVED, TRACE_ADDRESS(neighbor_address),
+	  seq_num, power);
 
   STWRITE(DBGnd, address_write, neighbor_address);
   //STLOG(DBGnd || DBGmsgdat, " [");
@@ -429,6 +519,7 @@ int eond_process_hello_message(eond_state_t* state,
     if (link_message_size > buffer.size - buffer.pos) {
       STWARN("bad link message size, buffer remain.=%d, msg size=%d\n", 
 	     buffer.size-buffer.pos, message_size);
+      STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
       return -1;
     }
     if (link_code != EOND_Sym && link_code != EOND_Asym) {
@@ -455,14 +546,17 @@ int eond_process_hello_message(eond_state_t* state,
 
     if (link_buffer.status != HIPSENS_TRUE) {
       STWARN("parse error in link-hello message content\n");
+      STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
       return -1;
     }
   }
 
   if (buffer.status != HIPSENS_TRUE) {
     STWARN("parse error in hello message content\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return -1;
   }    
+  STMETRIC_INC(OPERA_METRIC_HELLO_PARSED);
   STLOG(DBGnd, "\n");
   
   eond_process_hello_update_neighbor(state, neighbor_address, power, seq_num,
@@ -619,6 +713,9 @@ int  eond_generate_hello_message(eond_state_t* state,
   ASSERT(result > 0);
   buffer.pos = msg_size_pos;
   buffer_put_u8(&buffer, result - msg_content_start_pos);
+  STTRACE(OPERA_TRACE_EOND_HELLO_GENERATED, state->hello_seq_num-1,
+	  result, count_total);
+  STMETRIC_INC(OPERA_METRIC_HELLO_GENERATED);
 
   return result;
 }
@@ -650,6 +747,11 @@ int eond_notify_wakeup(eond_state_t* state, void* packet, int max_packet_size)
   } else return packet_size;
 }
 
+#ifdef WITH_OPERA_TX_SCHEDULER
+hipsens_time_t eond_get_next_hello_time(eond_state_t* state)
+{ return state->next_msg_hello_time; }
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
 /*---------------------------------------------------------------------------*/
 
 #ifdef WITH_NEIGH_OPT
@@ -41,12 +41,27 @@
 #define WITH_DELAYED_STATE_UPDATE
 
 
+/**
+ * What to do with a new neighbor when the neighbor table is full.
+ * Neighbors which are parent or child in a tree (see protect_func)
+ * are never evicted.
+ */
+typedef enum {
+  EOND_Eviction_None = 0,      /**< the new neighbor is ignored */
+  EOND_Eviction_Weakest = 1,   /**< replace the entry with the lowest
+				  power, if lower than the new one
+				  (requires WITH_STAT, else as OldestAsym) */
+  EOND_Eviction_OldestAsym = 2 /**< replace the asymmetric entry which
+				  would expire first */
+} eond_eviction_policy_t;
+
 typedef struct s_eond_config_t {
   hipsens_u8     link_quality_pwr_low;
   hipsens_u8     link_quality_pwr_high;
   hipsens_time_t neigh_hold_time;
   hipsens_time_t max_jitter_time;
   hipsens_time_t hello_interval;
+  eond_eviction_policy_t eviction_policy;
 } eond_config_t;
 
 /**
@@ -113,6 +128,11 @@ typedef void (*eond_observer_func_t)(void* data, address_t neighbor_address,
 				     eond_neighbor_state_t new_state,
 				     int neighbor_index);
 
+/* returns whether a neighbor must not be evicted (see eond_config_t) */
+typedef hipsens_bool (*eond_protect_func_t)(void* data, 
+					    address_t neighbor_address,
+					    int neighbor_index);
+
 /**
  * The state of the Neighbor Discovery protocol in EOLSR
  */
@@ -125,6 +145,9 @@ typedef struct s_nd_state_t {
   //eond_neighbor_t neighbor_table[MAX_NEIGHBOR];
   int current_max_neighbor;
   int max_neighbor_limit;
+#elif defined(WITH_OPERA_ARENA)
+  eond_neighbor_t* neighbor_table; /**< in the arena (see opera_set_arena) */
+  int max_neighbor;
 #else
   eond_neighbor_t neighbor_table[MAX_NEIGHBOR];
 #endif  
@@ -138,6 +161,7 @@ typedef struct s_nd_state_t {
   /* callback for neighborhood change */
   eond_observer_func_t observer_func; /* XXX: put in hipsens-external-api.h */
   void* observer_data;
+  eond_protect_func_t protect_func; /**< called with observer_data */
 
   eond_config_t* config;
 
@@ -149,8 +173,32 @@ typedef struct s_nd_state_t {
 } eond_state_t;
 
 
+#if defined(WITH_NEIGH_OPT) && defined(WITH_OPERA_ARENA)
+#error "WITH_NEIGH_OPT and WITH_OPERA_ARENA are exclusive"
+#endif
+
+/*--------------------------------------------------
+ * Neighbor identifiers
+ *
+ * The EOND neighbor table is the registry of the neighbors for all the
+ * modules: the index of an entry is its identifier, which stays the same
+ * as long as the entry is not EOND_None (entries are never moved).
+ * Other modules refer to neighbors by identifier rather than by address.
+ *--------------------------------------------------*/
+
+typedef hipsens_u16 neighbor_id_t;
+
+#define NEIGHBOR_ID_NONE ((neighbor_id_t)0xffffu)
+
+#define EOND_NEIGHBOR_ID(state, neighbor) \
+  ((neighbor_id_t)((neighbor) - (state)->neighbor_table))
+#define EOND_NEIGHBOR_BY_ID(state, neighbor_id) \
+  (&((state)->neighbor_table[(neighbor_id)]))
+
 #ifdef WITH_NEIGH_OPT
 #define EOND_MAX_NEIGHBOR(state) ((state)->current_max_neighbor)
+#elif defined(WITH_OPERA_ARENA)
+#define EOND_MAX_NEIGHBOR(state) ((state)->max_neighbor)
 #else
 #define EOND_MAX_NEIGHBOR(state) MAX_NEIGHBOR
 #endif
@@ -194,11 +242,18 @@ int eond_estimate_nb_3hop(eond_state_t* state);
 eond_neighbor_t* eond_find_neighbor_by_address(eond_state_t*state,
 					       address_t address);
 
+/** return NEIGHBOR_ID_NONE if not found */
+neighbor_id_t eond_find_neighbor_id(eond_state_t* state, address_t address);
+
 void eond_check_expiration(eond_state_t* state);
 
 void eond_get_next_wakeup_condition(eond_state_t* state, 
 				    hipsens_wakeup_condition_t* condition);
 int eond_notify_wakeup(eond_state_t* state, void* packet, int max_packet_size);
+#ifdef WITH_OPERA_TX_SCHEDULER
+/* time at which a Hello should be generated (maybe in the past) */
+hipsens_time_t eond_get_next_hello_time(eond_state_t* state);
+#endif /* WITH_OPERA_TX_SCHEDULER */
 
 #ifdef WITH_PRINTF
 void eond_pywrite(outstream_t out, eond_state_t* state);
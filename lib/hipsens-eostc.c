@@ -84,7 +84,7 @@
 
 /*---------------------------------------------------------------------------*/
 
-#if STC_TREE_MINE > MAX_STC_TREE
+#if MAX_STC_SERENA_TREE > MAX_STC_TREE
 #error "Bad configuration, MAX_STC_TREE < MAX_STC_SERENA_TREE"
 #endif
 
@@ -109,6 +109,8 @@ void eostc_config_init_default(eostc_config_t* config)
   config->tree_hold_time = SEC_TO_HIPSENS_TIME(DEFAULT_TREE_HOLD_TIME_SEC);
   config->stability_time = SEC_TO_HIPSENS_TIME(DEFAULT_STABILITY_DELAY_SEC);
 #endif /* WITH_FRAME_TIME */
+  config->tree_eviction_policy = EOSTC_Eviction_None;
+  config->child_eviction_policy = EOSTC_Eviction_None;
 }
 
 
@@ -140,6 +142,46 @@ static void eostc_event_topology_change(eostc_state_t* state,
   }
 }
 
+static void eostc_apply_neighborhood_topology_change(eostc_state_t* state,
+						     int flag_bit_to_set)
+{
+  int i;
+  for (i=0; i<EOSTC_MAX_TREE(state); i++)
+    if (state->tree[i].status == EOSTC_HasParent)
+      eostc_event_topology_change(state, &state->tree[i], flag_bit_to_set);
+}
+
+/* A topology change makes the serena trees unstable: only the first of
+   several changes may set a flag, the next ones only repeat the same
+   stability_time, hence one change per batch is equivalent. */
+static void eostc_neighborhood_topology_change(eostc_state_t* state,
+					       int flag_bit_to_set)
+{
+  if (!state->is_topology_change_deferred) {
+    eostc_apply_neighborhood_topology_change(state, flag_bit_to_set);
+    return;
+  }
+  if (!state->has_deferred_topology_change) {
+    state->has_deferred_topology_change = HIPSENS_TRUE;
+    state->deferred_topology_flag = flag_bit_to_set;
+  }
+}
+
+void eostc_begin_neighbor_change_batch(eostc_state_t* state)
+{
+  state->is_topology_change_deferred = HIPSENS_TRUE;
+}
+
+void eostc_end_neighbor_change_batch(eostc_state_t* state)
+{
+  state->is_topology_change_deferred = HIPSENS_FALSE;
+  if (state->has_deferred_topology_change) {
+    state->has_deferred_topology_change = HIPSENS_FALSE;
+    eostc_apply_neighborhood_topology_change
+      (state, state->deferred_topology_flag);
+  }
+}
+
 static void eostc_handle_neighbor_change
 (void* data, address_t neighbor_address,
  eond_neighbor_state_t old_state, eond_neighbor_state_t new_state,
@@ -156,17 +198,16 @@ static void eostc_handle_neighbor_change
 
     int i,j;
 
-    for (i=0; i<MAX_STC_TREE; i++) {
+    for (i=0; i<EOSTC_MAX_TREE(state); i++) {
       eostc_tree_t* tree = &state->tree[i];
-      if (tree->status == EOSTC_HasParent) {
-	if (hipsens_is_tree_being_colored(state, tree))
-	  hipsens_notify_neighbor_disappeared(state->base, neighbor_address);
-	eostc_event_topology_change(state, &state->tree[i], EOSTC_NO_FLAG);
-      }
+      if (tree->status == EOSTC_HasParent
+	  && hipsens_is_tree_being_colored(state, tree))
+	hipsens_notify_neighbor_disappeared(state->base, neighbor_address);
     }
+    eostc_neighborhood_topology_change(state, EOSTC_NO_FLAG);
 
     /* remove all trees where the node is parent */
-    for (i=0; i<MAX_STC_TREE; i++) {
+    for (i=0; i<EOSTC_MAX_TREE(state); i++) {
       eostc_tree_t* tree = &state->tree[i];
       if (tree->status == EOSTC_HasParent 
 	  && hipsens_address_equal(tree->parent_address, neighbor_address)) {
@@ -178,36 +219,71 @@ static void eostc_handle_neighbor_change
       }
     }
 
-    /* remove it also as child of all trees */
-    for (i=0; i<MAX_STC_TREE; i++)
-      if (state->tree[i].status != EOSTC_None 
-	  && state->tree[i].serena_info != NULL) {
+    /* remove it also as child of all trees (including the unused ones,
+       because its identifier may be reused by EOND) */
+    for (i=0; i<EOSTC_MAX_TREE(state); i++)
+      if (state->tree[i].serena_info != NULL) {
 	eostc_serena_tree_t* serena_tree = state->tree[i].serena_info;
-	for (j=0; j<MAX_NEIGHBOR; j++) {
+	for (j=0; j<EOSTC_MAX_CHILD(serena_tree); j++) {
 	  eostc_child_t* child = &serena_tree->child[j];
 	  if (child->status != Child_None
-	      && hipsens_address_equal(child->address, neighbor_address)) {
+	      && child->neighbor_id == (neighbor_id_t)neighbor_index) {
+	    if (state->tree[i].status != EOSTC_None) {
+	      IFSTAT( state->stat_child_disappear++ );
+	      is_relative = HIPSENS_TRUE;
+	    }
 	    child->status = Child_None;
-	    IFSTAT( state->stat_child_disappear++ );
-	    is_relative = HIPSENS_TRUE;
 	  }
 	}
       }
   } else if (new_state == EOND_Sym) {
     int i;
-    for (i=0; i<MAX_STC_TREE; i++) {
+    for (i=0; i<EOSTC_MAX_TREE(state); i++) {
       eostc_tree_t* tree = &state->tree[i];
-      if (tree->status == EOSTC_HasParent) {
-	if (hipsens_is_tree_being_colored(state, tree))
-	  hipsens_notify_neighbor_disappeared(state->base, neighbor_address);
-	eostc_event_topology_change(state, &state->tree[i],
-				    EOSTC_FLAG_NEW_NEIGHBOR);
-      }
+      if (tree->status == EOSTC_HasParent
+	  && hipsens_is_tree_being_colored(state, tree))
+	hipsens_notify_neighbor_disappeared(state->base, neighbor_address);
+    }
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+    for (i=0; i<EOSTC_MAX_TREE(state); i++) {
+      eostc_tree_t* tree = &state->tree[i];
+      if (tree->status != EOSTC_None && IS_FOR_SERENA(*tree))
+	hipsens_notify_neighbor_appeared(state->base, neighbor_address,
+					 neighbor_index, tree);
     }
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+    eostc_neighborhood_topology_change(state, EOSTC_FLAG_NEW_NEIGHBOR);
 
   }
 }
 
+/* a parent or a child in one of the trees must stay in EOND */
+static hipsens_bool eostc_is_neighbor_relative(void* data,
+					       address_t neighbor_address,
+					       int neighbor_index)
+{
+  eostc_state_t* state = (eostc_state_t*)data;
+  int i,j;
+  for (i=0; i<EOSTC_MAX_TREE(state); i++) {
+    eostc_tree_t* tree = &state->tree[i];
+    if (tree->status == EOSTC_None)
+      continue;
+    if (tree->status == EOSTC_HasParent 
+	&& hipsens_address_equal(tree->parent_address, neighbor_address))
+      return HIPSENS_TRUE;
+    if (tree->serena_info != NULL) {
+      eostc_serena_tree_t* serena_tree = tree->serena_info;
+      for (j=0; j<EOSTC_MAX_CHILD(serena_tree); j++) {
+	eostc_child_t* child = &serena_tree->child[j];
+	if (child->status != Child_None
+	    && child->neighbor_id == (neighbor_id_t)neighbor_index)
+	  return HIPSENS_TRUE;
+      }
+    }
+  }
+  return HIPSENS_FALSE;
+}
+
 static void eostc_update_next_stc_time(eostc_state_t* state)
 {
   state->next_msg_stc_time = base_state_time_after_delay_jitter
@@ -296,24 +372,26 @@ static eostc_tree_t* eostc_find_free_tree(eostc_state_t* state,
   int i;
 
   if (!is_for_serena) {
-    for (i=0; i<MAX_STC_TREE; i++)
-      if (i != STC_TREE_MINE && i != STC_SERENA_TREE_MINE
+    for (i=0; i<EOSTC_MAX_TREE(state); i++)
+      if (i != STC_TREE_MINE(state) && i != STC_SERENA_TREE_MINE
 	  && state->tree[i].serena_info == NULL
 	  && state->tree[i].status == EOSTC_None)
 	return &state->tree[i];
 //    return NULL; // XXX: we no longer use colored trees in this case
+    if (state->config->tree_eviction_policy == EOSTC_Eviction_NonColoredFirst)
+      return NULL; /* keep the colored tree entries for colored trees */
 
     //if (!is_for_serena && state->tree[STC_TREE_MINE].status == EOSTC_None)
     //return &state->tree[STC_TREE_MINE];
   }
 
-  for (i=0; i<MAX_STC_TREE; i++)
-    if (i != STC_TREE_MINE && i != STC_SERENA_TREE_MINE
+  for (i=0; i<EOSTC_MAX_TREE(state); i++)
+    if (i != STC_TREE_MINE(state) && i != STC_SERENA_TREE_MINE
 	&& state->tree[i].serena_info != NULL 
 	&& state->tree[i].status == EOSTC_None)
       return &state->tree[i];
 
-  if (MAX_STC_SERENA_TREE > 0
+  if (EOSTC_MAX_SERENA_TREE(state) > 0
       && state->tree[STC_SERENA_TREE_MINE].status == EOSTC_None)
     return &state->tree[STC_SERENA_TREE_MINE];
 
@@ -327,7 +405,7 @@ eostc_tree_t* eond_find_tree_by_address
 (eostc_state_t* state, address_t address, hipsens_bool is_for_serena)
 {
   int i;
-  for (i=0;i<MAX_STC_TREE; i++) {
+  for (i=0;i<EOSTC_MAX_TREE(state); i++) {
     eostc_tree_t* tree = &state->tree[i];
     if (tree->status != EOSTC_None) {
       if (hipsens_address_equal(tree->root_address, address)
@@ -341,7 +419,7 @@ eostc_tree_t* eond_find_tree_by_address
 void clear_serena_tree(eostc_serena_tree_t* serena_tree)
 {
   int i;
-  for (i=0; i<MAX_NEIGHBOR; i++)
+  for (i=0; i<EOSTC_MAX_CHILD(serena_tree); i++)
     serena_tree->child[i].status = Child_None;
   serena_tree->flags = 0;
   serena_tree->should_generate_tree_status = HIPSENS_FALSE;
@@ -362,13 +440,13 @@ void eostc_state_reset(eostc_state_t* state)
 
   /* empty tables */
   int i;
-  for (i = 0; i<MAX_STC_TREE; i++) {
+  for (i = 0; i<EOSTC_MAX_TREE(state); i++) {
     eostc_tree_t* tree = &state->tree[i];
     tree->status = EOSTC_None;
     tree->serena_info = NULL;
   }
-  for (i = 0; i<MAX_STC_SERENA_TREE; i++) {
-    if (i < MAX_STC_TREE) {
+  for (i = 0; i<EOSTC_MAX_SERENA_TREE(state); i++) {
+    if (i < EOSTC_MAX_TREE(state)) {
       state->serena_info[i].tree = &state->tree[i];
       state->tree[i].serena_info = &state->serena_info[i];
       /* XXX: redundant */
@@ -376,6 +454,8 @@ void eostc_state_reset(eostc_state_t* state)
     } else state->serena_info[i].tree = NULL; /* unused */
   }
   state->my_tree  = NULL;
+  state->is_topology_change_deferred = HIPSENS_FALSE;
+  state->has_deferred_topology_change = HIPSENS_FALSE;
 
 #ifdef WITH_STAT
   state->stat_child_disappear = 0;
@@ -400,6 +480,7 @@ void eostc_state_init(eostc_state_t* state, eond_state_t* eond_state,
   }
   state->eond_state->observer_data = (void*) state;
   state->eond_state->observer_func = eostc_handle_neighbor_change;
+  state->eond_state->protect_func = eostc_is_neighbor_relative;
   eostc_state_reset(state);
 }
 
@@ -410,12 +491,12 @@ hipsens_bool eostc_start(eostc_state_t* state, hipsens_bool is_for_serena)
 {
   HIPSENS_GET_MY_ADDRESS(state->base, my_address);
 
-  if (is_for_serena && MAX_STC_SERENA_TREE == 0)
+  if (is_for_serena && EOSTC_MAX_SERENA_TREE(state) == 0)
     return HIPSENS_FALSE;
   if (state->my_tree == NULL) {
     if (is_for_serena)
       state->my_tree = &state->tree[STC_SERENA_TREE_MINE];
-    else state->my_tree = &state->tree[STC_TREE_MINE];
+    else state->my_tree = &state->tree[STC_TREE_MINE(state)];
   }
 
   eostc_tree_t* tree = state->my_tree;
@@ -532,13 +613,56 @@ static void eostc_refresh_tree(eostc_state_t* state,
   }
 }
 
+/* returns an entry of the tree table, freed for the tree of `message'
+   according to the tree eviction policy, or NULL */
+static eostc_tree_t* eostc_evict_tree(eostc_state_t* state,
+				      eostc_message_t* message)
+{
+  eostc_eviction_policy_t policy = state->config->tree_eviction_policy;
+  eostc_tree_t* result = NULL;
+  int i;
+  if (policy == EOSTC_Eviction_None)
+    return NULL;
+
+  for (i=0; i<EOSTC_MAX_TREE(state); i++) {
+    eostc_tree_t* tree = &state->tree[i];
+    if (i == STC_TREE_MINE(state) || tree->status != EOSTC_HasParent
+	|| IS_FOR_SERENA(*tree) != message->flag_colored
+	|| (IS_FOR_SERENA(*tree) && hipsens_is_tree_being_colored(state, tree)))
+      continue;
+
+    if (policy == EOSTC_Eviction_HighestCost) {
+      if (tree->current_cost > message->cost
+	  && (result == NULL || tree->current_cost > result->current_cost))
+	result = tree;
+    } else if (result == NULL
+	       || HIPSENS_TIME_COMPARE_NO_UNDEF
+	       (tree->validity_time, <, result->validity_time))
+      result = tree;
+  }
+
+  if (result != NULL) {
+    STLOG(DBGstc, " tree-evicted");
+    result->status = EOSTC_None;
+    if (result->serena_info != NULL)
+      clear_serena_tree(result->serena_info);
+  }
+  return result;
+}
+
 static void eostc_new_tree_discovered(eostc_state_t* state,
 				      eostc_message_t* message)
 {
   eostc_tree_t* tree = eostc_find_free_tree(state, message->flag_colored);
+  if (tree == NULL)
+    tree = eostc_evict_tree(state, message);
   if (tree == NULL) {
     STWARN("tree table full\n");
     STLOG(DBGstc," tree-table-full\n");
+    STMETRIC_INC(OPERA_METRIC_TREE_TABLE_FULL);
+    STTRACE(OPERA_TRACE_EOSTC_TREE_TABLE_FULL,
+	    TRACE_ADDRESS(message->tree_root_address),
+	    message->stc_seq_num, message->flag_colored);
     return;
   }
   tree->status = EOSTC_HasParent; /* XXX! status missing in spec. */
@@ -552,27 +676,46 @@ static void eostc_new_tree_discovered(eostc_state_t* state,
 			     HIPSENS_TRUE, HIPSENS_UNDEF);
 }
 
-static eostc_child_t* get_serena_tree_child(eostc_serena_tree_t* serena_tree,
-					    address_t child_address,
-					    hipsens_time_t current_time)
+static eostc_child_t* get_serena_tree_child(eostc_state_t* state,
+					    eostc_tree_t* tree,
+					    neighbor_id_t child_id)
 {
+  eostc_serena_tree_t* serena_tree = tree->serena_info;
+  eostc_eviction_policy_t policy = state->config->child_eviction_policy;
   int i;
-  int free_index = -1;
-  for (i=0; i<MAX_NEIGHBOR;i++) {
+  int free_index = -1, oldest_index = -1;
+  for (i=0; i<EOSTC_MAX_CHILD(serena_tree);i++) {
     eostc_child_t* child = &serena_tree->child[i];
     if (child->status == Child_None) {
       if (free_index < 0)
 	free_index = i;
     } else {
-      if (hipsens_address_equal(child_address, child->address))
+      if (child->neighbor_id == child_id)
 	return child;
+      if (oldest_index < 0
+	  || HIPSENS_TIME_COMPARE_NO_UNDEF
+	  (child->validity_time, <, 
+	   serena_tree->child[oldest_index].validity_time))
+	oldest_index = i;
     }
   }
 
   if (free_index >= 0) {
     eostc_child_t* child = &serena_tree->child[free_index];
     return child;
-  } else return NULL; /* table is full */
+  }
+  if (policy != EOSTC_Eviction_None && oldest_index >= 0) {
+    eostc_child_t* child = &serena_tree->child[oldest_index];
+    /* the live children of a tree being colored are kept */
+    if (HIPSENS_TIME_COMPARE_NO_UNDEF
+	(child->validity_time, >=, state->base->current_time)
+	&& hipsens_is_tree_being_colored(state, tree))
+      return NULL;
+    /* the caller handles it as a new child */
+    child->status = Child_None;
+    return child;
+  }
+  return NULL; /* table is full */
 }
 
 /* - this is called when:
@@ -597,7 +740,7 @@ static void update_tree_stability_status(eostc_state_t* state,
   int i;
 
   /* check expiration + stability of the children */
-  for (i=0;i<MAX_NEIGHBOR;i++) {
+  for (i=0;i<EOSTC_MAX_CHILD(serena_tree);i++) {
     eostc_child_t* child = &serena_tree->child[i];
     
     if (child->status != Child_None) {
@@ -632,13 +775,13 @@ static void update_tree_stability_status(eostc_state_t* state,
 
 
 static eostc_child_t* eostc_find_child_in_tree(eostc_serena_tree_t* serena_tree,
-					       address_t sender_address)
+					       neighbor_id_t sender_id)
 {
   int i;
   eostc_child_t* child = NULL;
-  for (i=0; i<MAX_NEIGHBOR; i++)
+  for (i=0; i<EOSTC_MAX_CHILD(serena_tree); i++)
     if (serena_tree->child[i].status != Child_None
-	&& hipsens_address_equal(serena_tree->child[i].address, sender_address))
+	&& serena_tree->child[i].neighbor_id == sender_id)
       child = &serena_tree->child[i];
   return child;
 }
@@ -654,10 +797,14 @@ int eostc_process_tree_status_message(eostc_state_t* state,
   hipsens_u8 message_type = buffer_get_u8(&buffer);
   hipsens_u8 message_size = buffer_get_u8(&buffer);
   
-  if (message_type != HIPSENS_MSG_TREE_STATUS)
+  if (message_type != HIPSENS_MSG_TREE_STATUS) {
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return EOSTC_BAD_MSG_TYPE;
-  if (message_size > buffer.size - buffer.pos) 
+  }
+  if (message_size > buffer.size - buffer.pos) {
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return EOSTC_BAD_SIZE_PARSE;
+  }
 
   int result = buffer.pos + message_size;
   buffer.size = result;
@@ -676,8 +823,10 @@ int eostc_process_tree_status_message(eostc_state_t* state,
 
   /* --- update size field */
   if (buffer.status != HIPSENS_TRUE) {
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return EOSTC_BAD_SIZE_GENERATE;
   }
+  STMETRIC_INC(OPERA_METRIC_TREE_STATUS_PARSED);
 
   /* --- accept message only from symmetric neighbors */
   eond_neighbor_t* neighbor = eond_find_neighbor_by_address
@@ -734,7 +883,8 @@ int eostc_process_tree_status_message(eostc_state_t* state,
     return result; /* no more processing to do */
   }
 
-  eostc_child_t* child = eostc_find_child_in_tree(serena_tree, sender_address);
+  eostc_child_t* child = eostc_find_child_in_tree
+    (serena_tree, EOND_NEIGHBOR_ID(state->eond_state, neighbor));
 
   if (child != NULL) {
     /* - child found, update it */
@@ -765,6 +915,7 @@ int eostc_process_tree_status_message(eostc_state_t* state,
 
 static void process_stc_message_from_child(eostc_state_t* state,
 					   eostc_message_t* message,
+					   neighbor_id_t sender_id,
 					   eostc_tree_t* tree,
 					   hipsens_s8 seqnum_cmp)
 {
@@ -772,23 +923,23 @@ static void process_stc_message_from_child(eostc_state_t* state,
   if (tree->serena_info != NULL) {
     if (seqnum_cmp <= 0)  {
       /* ensure the child is in the children list */
-      eostc_child_t* child = get_serena_tree_child
-	(tree->serena_info, message->sender_address, state->base->current_time);
+      eostc_child_t* child = get_serena_tree_child(state, tree, sender_id);
       if (child != NULL) {
 	if (child->status == Child_None) {
 	  /* new children */
-	  hipsens_address_copy(child->address, message->sender_address);
+	  child->neighbor_id = sender_id;
 	  child->status = Child_Unstable;
 	  child->nb_descendant = 0;
 	  eostc_event_topology_change(state, tree, EOSTC_FLAG_TREE_CHANGE);
 	  /* XXX: test that parent and child are different ?! */
-	  hipsens_notify_tree_change(state->base, child->address, tree,
+	  hipsens_notify_tree_change(state->base, message->sender_address, tree,
 				     HIPSENS_UNDEF, HIPSENS_TRUE);
 	}
 	child->validity_time = HIPSENS_TIME_ADD
 	  (state->base->current_time,vtime_to_hipsens_time(message->vtime));
       } else {
 	STWARN("children table full.\n");
+	STMETRIC_INC(OPERA_METRIC_CHILD_TABLE_FULL);
       }
     } else {
       /* this should not happen in normal functionning of the protocol */
@@ -809,25 +960,32 @@ int eostc_process_stc_message(eostc_state_t* state,
 
   if (result == EOSTC_BAD_MSG_TYPE) {
     STWARN("bad message type, stc message expected");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return -1;
   } else if (result == EOSTC_BAD_SIZE_GENERATE) {
     STWARN("bad message size");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return -1;
   } else if (result < 0) {
     STWARN("parse error in stc message content\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return -1;
   }
+  STMETRIC_INC(OPERA_METRIC_STC_PARSED);
 
   if (hipsens_address_equal(message.sender_address, my_address)) {
     STLOG(DBGstc, "- ignoring packet from myself\n");
     return result;
   }
+  STTRACE(OPERA_TRACE_EOSTC_STC_RECEIVED, TRACE_ADDRESS(message.sender_address),
+	  TRACE_ADDRESS(message.tree_root_address), message.stc_seq_num);
 
 
   eond_neighbor_t* neighbor = eond_find_neighbor_by_address
     (state->eond_state, message.sender_address);
   if (neighbor == NULL || neighbor->state != EOND_Sym)
     return result; /* not from a symmetric neighbor: ignore message */
+  neighbor_id_t sender_id = EOND_NEIGHBOR_ID(state->eond_state, neighbor);
 
   eostc_tree_t* tree = eond_find_tree_by_address
     (state, message.tree_root_address, message.flag_colored);
@@ -845,7 +1003,8 @@ int eostc_process_stc_message(eostc_state_t* state,
 	&& tree != NULL) {
       int seqnum_cmp = hipsens_seqnum_cmp(message.stc_seq_num, 
 					  tree->stc_seq_num);
-      process_stc_message_from_child(state, &message, tree, seqnum_cmp);
+      process_stc_message_from_child(state, &message, sender_id, tree,
+				     seqnum_cmp);
     }
     return result;
   }
@@ -877,7 +1036,8 @@ int eostc_process_stc_message(eostc_state_t* state,
 	}
       } else if (hipsens_address_equal(message.parent_address, my_address)) {
 
-	process_stc_message_from_child(state, &message, tree, seqnum_cmp);
+	process_stc_message_from_child(state, &message, sender_id, tree,
+				       seqnum_cmp);
 
       } else {
 	/* message coming neither from parent nor from child */
@@ -887,7 +1047,7 @@ int eostc_process_stc_message(eostc_state_t* state,
 	  eostc_serena_tree_t* serena_tree = tree->serena_info;
 	  ASSERT( tree->serena_info != NULL );
 	  eostc_child_t* child = eostc_find_child_in_tree
-	    (serena_tree, message.sender_address);
+	    (serena_tree, sender_id);
 	  if (child != NULL) {
 #warning "[CA] not updating stability status/timers on detection of child parent change"
 	    child->status = Child_None; /* remove the child */
@@ -898,6 +1058,7 @@ int eostc_process_stc_message(eostc_state_t* state,
 
 	if (message.cost < tree->current_cost && seqnum_cmp >= 0) {
 	  /* parent change */
+	  STMETRIC_INC(OPERA_METRIC_PARENT_CHANGE);
 	  eostc_event_topology_change(state, tree, EOSTC_FLAG_TREE_CHANGE);
 	  hipsens_address_copy(tree->parent_address, message.sender_address);
 	  eostc_refresh_tree(state, tree, &message, HIPSENS_TRUE, HIPSENS_TRUE);
@@ -915,6 +1076,9 @@ int eostc_process_stc_message(eostc_state_t* state,
 	/* greater message seq num: if it does not come from a child,
 	   select the sender as parent */
 	if (!hipsens_address_equal(message.parent_address, my_address)) {
+	  if (!hipsens_address_equal(tree->parent_address,
+				     message.sender_address))
+	    STMETRIC_INC(OPERA_METRIC_PARENT_CHANGE);
 	  hipsens_address_copy(tree->parent_address, message.sender_address);
 	  eostc_refresh_tree(state, tree, &message, 
 			     HIPSENS_TRUE, HIPSENS_UNDEF);
@@ -973,6 +1137,9 @@ static int eostc_repeat_stc_message(eostc_state_t* state,
     WARN(state->base, "packet buffer too small\n");
     return -1; /* buffer overflow */
   }
+  STTRACE(OPERA_TRACE_EOSTC_STC_REPEATED, TRACE_ADDRESS(tree->root_address),
+	  message.stc_seq_num, message.cost);
+  STMETRIC_INC(OPERA_METRIC_STC_GENERATED);
 
   return result;
 }
@@ -980,7 +1147,7 @@ static int eostc_repeat_stc_message(eostc_state_t* state,
 static eostc_tree_t* eostc_get_pending_stc_tree(eostc_state_t* state)
 {
   int i=0;
-  for (i=0; i<MAX_STC_TREE; i++) 
+  for (i=0; i<EOSTC_MAX_TREE(state); i++) 
     if (state->tree[i].status != EOSTC_None 
 	&& state->tree[i].ttl_if_generate > 0)
       return &state->tree[i];
@@ -990,7 +1157,7 @@ static eostc_tree_t* eostc_get_pending_stc_tree(eostc_state_t* state)
 static eostc_tree_t* eostc_get_pending_tree_status_tree(eostc_state_t* state)
 {
   int i=0;
-  for (i=0; i<MAX_STC_TREE; i++) 
+  for (i=0; i<EOSTC_MAX_TREE(state); i++) 
     if (state->tree[i].status != EOSTC_None 
 	&& IS_FOR_SERENA(state->tree[i]) 
 	&& state->tree[i].serena_info->should_generate_tree_status
@@ -1052,6 +1219,9 @@ int  eostc_generate_stc_message(eostc_state_t* state,
     WARN(state->base, "packet buffer too small.\n");
     return -1; /* buffer overflow */
   }
+  STTRACE(OPERA_TRACE_EOSTC_STC_GENERATED, message.stc_seq_num,
+	  message.tree_seq_num, message.flags);
+  STMETRIC_INC(OPERA_METRIC_STC_GENERATED);
 
   return result;
 }
@@ -1062,7 +1232,7 @@ int eostc_count_descendant(eostc_state_t* state, eostc_tree_t* tree)
   eostc_serena_tree_t* serena_tree = tree->serena_info;
   int nb_descendant = 1 /* the node itself */;
   int i;
-  for (i=0;i<MAX_NEIGHBOR;i++)
+  for (i=0;i<EOSTC_MAX_CHILD(serena_tree);i++)
     if (serena_tree->child[i].status == Child_Stable)
       nb_descendant += serena_tree->child[i].nb_descendant;
   return nb_descendant;
@@ -1106,6 +1276,10 @@ int eostc_generate_tree_status_message(eostc_state_t* state,
   ASSERT(result > 0);
   buffer.pos = msg_size_pos;
   buffer_put_u8(&buffer, result - msg_content_start_pos);
+  STTRACE(OPERA_TRACE_EOSTC_TREE_STATUS_GENERATED,
+	  TRACE_ADDRESS(tree->root_address), serena_tree->tree_seq_num,
+	  nb_descendant);
+  STMETRIC_INC(OPERA_METRIC_TREE_STATUS_GENERATED);
   return result;
 }
 
@@ -1122,7 +1296,8 @@ void eostc_get_next_wakeup_condition(eostc_state_t* state,
     condition->wakeup_time_buffer = state->base->current_time;
 }
 
-int eostc_notify_wakeup(eostc_state_t* state, byte* packet, int max_packet_size)
+int eostc_notify_wakeup_stc(eostc_state_t* state, 
+			    byte* packet, int max_packet_size)
 {
   if (packet == NULL)
     return 0;
@@ -1141,17 +1316,18 @@ int eostc_notify_wakeup(eostc_state_t* state, byte* packet, int max_packet_size)
     packet_size = eostc_generate_stc_message(state, packet, max_packet_size);
   }
 
-  if (packet_size < 0) {
+  if (packet_size < 0)
     STWARN("eond_notify_wakeup: eostc message generation/forwarding failed\n"); 
-    return 0;
-  } 
-
-  if (packet_size > 0)
-    return packet_size; /* no concatenation */
+  return packet_size;
+}
 
-  packet += packet_size;
-  max_packet_size -= packet_size;
+int eostc_notify_wakeup_tree_status(eostc_state_t* state, 
+				    byte* packet, int max_packet_size)
+{
+  if (packet == NULL)
+    return 0;
 
+  int packet_size = 0;
   eostc_tree_t* tree = eostc_get_pending_tree_status_tree(state);
   if (tree != NULL) {
     packet_size = eostc_generate_tree_status_message(state, tree, packet,
@@ -1164,6 +1340,32 @@ int eostc_notify_wakeup(eostc_state_t* state, byte* packet, int max_packet_size)
   return packet_size;
 }
 
+int eostc_notify_wakeup(eostc_state_t* state, byte* packet, int max_packet_size)
+{
+  int packet_size = eostc_notify_wakeup_stc(state, packet, max_packet_size);
+  if (packet_size < 0)
+    return 0;
+  if (packet_size > 0)
+    return packet_size; /* no concatenation */
+  return eostc_notify_wakeup_tree_status(state, packet, max_packet_size);
+}
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+hipsens_time_t eostc_get_next_stc_time(eostc_state_t* state)
+{
+  if (eostc_get_pending_stc_tree(state) != NULL)
+    return state->base->current_time; /* STC to repeat */
+  return state->next_msg_stc_time;
+}
+
+hipsens_time_t eostc_get_next_tree_status_time(eostc_state_t* state)
+{
+  if (eostc_get_pending_tree_status_tree(state) != NULL)
+    return state->base->current_time;
+  return undefined_time;
+}
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
 /*---------------------------------------------------------------------------*/
 
 #ifdef WITH_PRINTF
@@ -1195,7 +1397,7 @@ void eostc_pywrite(outstream_t out, eostc_state_t* state)
   FPRINTF(out, ",\n  'treeTable':[");
   int i;
   hipsens_bool isFirst = HIPSENS_TRUE;
-  for (i=0; i<MAX_STC_TREE; i++)
+  for (i=0; i<EOSTC_MAX_TREE(state); i++)
     if (state->tree[i].status != EOSTC_None) {
       if (isFirst) isFirst = HIPSENS_FALSE;
       else FPRINTF(out, ",");
@@ -1239,13 +1441,13 @@ void eostc_pywrite(outstream_t out, eostc_state_t* state)
 	FPRINTF(out, ", 'childTable':[");
 	int j;
 	hipsens_bool isFirstChild = HIPSENS_TRUE;
-	for (j=0;j<MAX_NEIGHBOR;j++)
+	for (j=0;j<EOSTC_MAX_CHILD(tree->serena_info);j++)
 	  if (tree->serena_info->child[j].status != Child_None) {
 	    eostc_child_t* child = &tree->serena_info->child[j];
 	    if (isFirstChild) isFirstChild = HIPSENS_FALSE;
 	    else FPRINTF(out, ",");
 	    FPRINTF(out, "{'address':");
-	    address_pywrite(out, child->address);
+	    address_pywrite(out, EOSTC_CHILD_ADDRESS(state, child));
 	    FPRINTF(out, ", 'nbDescendant':% d", child->nb_descendant);
 	    FPRINTF(out, ", 'status': %s", 
 		    child_status_as_string(child->status));
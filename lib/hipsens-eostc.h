@@ -40,11 +40,32 @@
 
 //#define EOSTC_MY_TREE 0
 
+/**
+ * What to do with a new tree (resp. child) when the tree table (resp.
+ * the children table of a colored tree) is full.
+ * The trees rooted at this node and the trees being colored are never
+ * evicted ; children have no cost, and HighestCost and NonColoredFirst 
+ * are the same as LeastRefreshed for them. While a tree is being colored,
+ * only its expired children are evicted.
+ */
+typedef enum {
+  EOSTC_Eviction_None = 0,           /**< the new entry is ignored */
+  EOSTC_Eviction_LeastRefreshed = 1, /**< replace the entry which would 
+					expire first (or has expired) */
+  EOSTC_Eviction_HighestCost = 2,    /**< replace the tree with the highest
+					cost, if higher than the new one */
+  EOSTC_Eviction_NonColoredFirst = 3 /**< as LeastRefreshed, but the entries
+					of colored trees are reserved for
+					colored trees */
+} eostc_eviction_policy_t;
+
 typedef struct s_eostc_config_t {
   hipsens_time_t max_jitter_time; /**< for both gen. and retransmit. */
   hipsens_time_t stc_interval; /**< STCMax = STCMin */
   hipsens_time_t tree_hold_time; 
   hipsens_time_t stability_time;  
+  eostc_eviction_policy_t tree_eviction_policy;
+  eostc_eviction_policy_t child_eviction_policy;
 } eostc_config_t;
 
 typedef enum {
@@ -65,7 +86,7 @@ typedef enum {
 
 
 typedef struct s_eostc_child_t {
-  address_t address;            /**< C_child_addr */
+  neighbor_id_t neighbor_id;    /**< C_child_addr (as EOND identifier) */
   hipsens_u16 nb_descendant;    /**< C_descendants_number */
   child_status_t status;        /**< C_tree_status */
   hipsens_time_t validity_time; /**< C_validity_time */
@@ -83,9 +104,24 @@ typedef struct s_eostc_serena_tree_t {
   hipsens_bool has_sent_stable:1;
   hipsens_time_t stability_time; /**<  */
   hipsens_u16 tree_seq_num; /**< S_tree_seqnum */
+#ifdef WITH_OPERA_ARENA
+  eostc_child_t* child; /**< S_childrenset, in the arena */
+  hipsens_u16 max_child;
+#else
   eostc_child_t child[MAX_NEIGHBOR]; /**< S_childrenset */
+#endif
 } eostc_serena_tree_t;
 
+#ifdef WITH_OPERA_ARENA
+#define EOSTC_MAX_CHILD(serena_tree) ((serena_tree)->max_child)
+#else
+#define EOSTC_MAX_CHILD(serena_tree) MAX_NEIGHBOR
+#endif
+
+/** the address of a child (it is always a symmetric neighbor in EOND) */
+#define EOSTC_CHILD_ADDRESS(state, child) \
+  (EOND_NEIGHBOR_BY_ID((state)->eond_state, (child)->neighbor_id)->address)
+
 /* invariants: 
    - all the active tree have a valid parent_address 
 */
@@ -109,7 +145,7 @@ typedef struct s_eostc_tree_t {
 #define IS_FOR_SERENA(tree) ((tree).serena_info != NULL)
 
 #define STC_SERENA_TREE_MINE 0
-#define STC_TREE_MINE MAX_STC_SERENA_TREE
+#define STC_TREE_MINE(state) EOSTC_MAX_SERENA_TREE(state)
 
 typedef struct s_eostc_state_t {
   base_state_t* base;
@@ -117,11 +153,25 @@ typedef struct s_eostc_state_t {
   eond_state_t* eond_state;
 
   eostc_tree_t* my_tree; /**< points to one of among the following */
+#ifdef WITH_OPERA_ARENA
+  /* in the arena (see opera_set_arena) */
+  eostc_tree_t* tree; /* Strategic Tree Table */
+  eostc_serena_tree_t* serena_info;
+  hipsens_u8 max_tree;
+  hipsens_u8 max_serena_tree;
+#else
   eostc_tree_t tree[MAX_STC_TREE]; /* Strategic Tree Table */
   eostc_serena_tree_t serena_info[MAX_STC_SERENA_TREE];
+#endif
   
   hipsens_time_t next_msg_stc_time; /**< time for next stc message */
 
+  /* topology changes from EOND, deferred during a batch of packets
+     (see eostc_begin_neighbor_change_batch) */
+  hipsens_bool is_topology_change_deferred;
+  hipsens_bool has_deferred_topology_change;
+  hipsens_s8 deferred_topology_flag; /**< flag of the first change */
+
 #ifdef WITH_STAT
   /* statistics */
   hipsens_u32 stat_child_disappear;
@@ -129,6 +179,14 @@ typedef struct s_eostc_state_t {
 #endif
 } eostc_state_t;
 
+#ifdef WITH_OPERA_ARENA
+#define EOSTC_MAX_TREE(state) ((state)->max_tree)
+#define EOSTC_MAX_SERENA_TREE(state) ((state)->max_serena_tree)
+#else
+#define EOSTC_MAX_TREE(state) MAX_STC_TREE
+#define EOSTC_MAX_SERENA_TREE(state) MAX_STC_SERENA_TREE
+#endif
+
 
 typedef struct s_eostc_message_t {
   address_t    sender_address;
@@ -182,8 +240,28 @@ int  eostc_generate_stc_message(eostc_state_t* state,
 
 void eostc_get_next_wakeup_condition(eostc_state_t* state,
 				     hipsens_wakeup_condition_t* condition);
+
+/**
+ * Between these two calls, the topology changes caused by EOND neighbor
+ * changes are applied only once, when the batch ends (the removal
+ * of children, parents and SERENA neighbors is still immediate).
+ * The batch must be ended before processing any EOSTC or SERENA message.
+ */
+void eostc_begin_neighbor_change_batch(eostc_state_t* state);
+void eostc_end_neighbor_change_batch(eostc_state_t* state);
 int eostc_notify_wakeup(eostc_state_t* state, 
 			byte* packet, int max_packet_size);
+/* the two parts of eostc_notify_wakeup (STC first, then Tree Status),
+   eostc_notify_wakeup_stc returns a negative value on failure */
+int eostc_notify_wakeup_stc(eostc_state_t* state, 
+			    byte* packet, int max_packet_size);
+int eostc_notify_wakeup_tree_status(eostc_state_t* state, 
+				    byte* packet, int max_packet_size);
+#ifdef WITH_OPERA_TX_SCHEDULER
+/* time at which a STC (resp. Tree Status) should be generated */
+hipsens_time_t eostc_get_next_stc_time(eostc_state_t* state);
+hipsens_time_t eostc_get_next_tree_status_time(eostc_state_t* state);
+#endif /* WITH_OPERA_TX_SCHEDULER */
 
 #ifdef WITH_PRINTF
 void eostc_pywrite(outstream_t out, eostc_state_t* state);
@@ -205,6 +283,12 @@ hipsens_bool hipsens_is_tree_being_colored(eostc_state_t* state,
 
 void hipsens_notify_neighbor_disappeared(base_state_t* base, address_t address);
 
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+/* a new symmetric neighbor, while `tree' may be colored */
+void hipsens_notify_neighbor_appeared(base_state_t* base, address_t address,
+				      int neighbor_index, eostc_tree_t* tree);
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
 void hipsens_notify_tree_change(base_state_t* base, address_t address,
 				eostc_tree_t* tree,
 				hipsens_tristate is_parent, 
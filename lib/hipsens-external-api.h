@@ -84,6 +84,25 @@ void hipsens_api_set_color_info
 (void* opaque_extra_info, byte node_color, 
  byte nb_neighbor_color, byte* neighbor_color_list);
 
+#ifdef WITH_OPERA_MULTI_SLOT
+/* Called by OPERA after hipsens_api_set_color_info, with all the colors
+   of the node, `node_color' included (numbered starting from 1, sorted
+   in the order of the slots); `neighbor_color_list' of
+   hipsens_api_set_color_info then has all the colors of the neighbors */
+void hipsens_api_set_node_color_list
+(void* opaque_extra_info, byte nb_node_color, byte* node_color_list);
+#endif /* WITH_OPERA_MULTI_SLOT */
+
+#ifdef WITH_OPERA_MULTI_CHANNEL
+/* Called by OPERA after hipsens_api_set_color_info, whose colors are then
+   slots (and nb_color of hipsens_api_set_nb_color the number of slots):
+   gives the channel (counting from 0) on which the node sends in its slot,
+   and the channel of each slot of `neighbor_color_list' (same order) */
+void hipsens_api_set_channel_info
+(void* opaque_extra_info, byte node_channel,
+ byte nb_neighbor_channel, byte* neighbor_channel_list);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
 /**
  * Returns the address of the node, by filling the (byte array) result_address
  * in OCARI, the address_t is the current short address.
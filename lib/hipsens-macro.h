@@ -129,15 +129,60 @@ typedef unsigned char outstream_t; /* not used */
 #define SET_WARNING(state) 
 #endif /* WITH_OPERA_SYSTEM_INFO */
 
+/*---------- binary trace (see trace_ring_t in hipsens-base.h) */
+
+#ifdef WITH_OPERA_TRACE
+#define TRACE(base_state, trace_event, arg0, arg1, arg2) BEGIN_MACRO	\
+  trace_record_t* _record = &((base_state)->trace.record		\
+     [(base_state)->trace.count & (OPERA_TRACE_SIZE-1)]);		\
+  _record->time = (base_state)->current_time;				\
+  _record->event = (trace_event);					\
+  _record->arg[0] = (hipsens_u16)(arg0);				\
+  _record->arg[1] = (hipsens_u16)(arg1);				\
+  _record->arg[2] = (hipsens_u16)(arg2);				\
+  (base_state)->trace.count ++;						\
+  END_MACRO
+#else /* --- */
+#define TRACE(base_state, trace_event, arg0, arg1, arg2) BEGIN_MACRO END_MACRO
+#endif /* WITH_OPERA_TRACE */
+
+/*---------- metrics (see opera_metric_t in hipsens-base.h) */
+
+#ifdef WITH_OPERA_METRICS
+#define METRIC_ADD(base_state, metric_id, value) BEGIN_MACRO	\
+  (base_state)->metric[(metric_id)] += (value);			\
+  END_MACRO
+#else /* --- */
+#define METRIC_ADD(base_state, metric_id, value) BEGIN_MACRO END_MACRO
+#endif /* WITH_OPERA_METRICS */
+
+#define METRIC_INC(base_state, metric_id) METRIC_ADD(base_state, metric_id, 1)
+
+/*---------- profile (see opera_profile_point_t in hipsens-base.h) */
+
+/* PROFILE_BEGIN declares the variable `start_var' (in the current block) */
+#ifdef WITH_OPERA_PROFILE
+#define PROFILE_BEGIN(start_var)			\
+  hipsens_u32 start_var = OPERA_PROFILE_CLOCK()
+#define PROFILE_END(base_state, point, start_var)			\
+  base_state_profile_add((base_state), (point),				\
+			 OPERA_PROFILE_CLOCK() - (start_var))
+#else /* --- */
+#define PROFILE_BEGIN(start_var)
+#define PROFILE_END(base_state, point, start_var) BEGIN_MACRO END_MACRO
+#endif /* WITH_OPERA_PROFILE */
+
 #define WARN(base_state, ...) BEGIN_MACRO			\
   (base_state)->warning_count ++;				\
   SET_WARNING(base_state)                                       \
+  TRACE(base_state, OPERA_TRACE_WARNING, __LINE__, 0, 0);	\
   FPRINTF(OUTERR, "warning (%s:%d): ", __func__, __LINE__);	\
   FPRINTF(OUTERR, __VA_ARGS__);					\
   END_MACRO
 
 #define FATAL(base_state, ...) BEGIN_MACRO		        \
   (base_state)->error_count ++;				        \
+  TRACE(base_state, OPERA_TRACE_FATAL, __LINE__, 0, 0);	        \
   FPRINTF(OUTERR, "fatal (%s:%d): ", __func__, __LINE__);	\
   FPRINTF(OUTERR, __VA_ARGS__);				        \
   base_state_abort(base_state); \
@@ -221,6 +266,14 @@ typedef unsigned char outstream_t; /* not used */
 #define STLOG(should_log, ...)			\
     BEGIN_MACRO_LOG LOG(state->base, should_log, __VA_ARGS__); END_MACRO_LOG
 
+#define STTRACE(trace_event, arg0, arg1, arg2) \
+  TRACE(state->base, trace_event, arg0, arg1, arg2)
+
+#define STMETRIC_INC(metric_id) METRIC_INC(state->base, metric_id)
+#define STMETRIC_ADD(metric_id, value) METRIC_ADD(state->base, metric_id, value)
+#define STPROFILE_END(point, start_var) \
+  PROFILE_END(state->base, point, start_var)
+
 #define STFATAL(...) FATAL(state->base, __VA_ARGS__)
 #define STWARN(...)  WARN(state->base, __VA_ARGS__)
 
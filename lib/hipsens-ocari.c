@@ -105,8 +105,19 @@ extern opera_config_t opera_config;
 extern opera_state_t opera;
 
 void ocari_init_opera_config(void);
+#ifdef WITH_OPERA_ARENA
+static byte ocari_opera_arena[OPERA_ARENA_SIZE(MAX_NEIGHBOR, MAX_STC_TREE,
+					       MAX_STC_SERENA_TREE)];
+#endif /* WITH_OPERA_ARENA */
+
 void ocari_init_opera_config(void)
 {
+#ifdef WITH_OPERA_ARENA
+  static opera_capacity_t capacity = 
+    { MAX_NEIGHBOR, MAX_STC_TREE, MAX_STC_SERENA_TREE };
+  if (opera.arena == NULL)
+    opera_set_arena(&opera, &capacity, ocari_opera_arena);
+#endif /* WITH_OPERA_ARENA */
   opera_update_config(&opera_config);
 //#warning "[CA] next line should be re-enabled"
   opera_init(&opera, &opera_config, NULL);
@@ -32,9 +32,10 @@
 /* XXX: the naming of these intermediary functions is inconsistent */
 
 /* 
-   Copy the topology from 
-
-   XXX: warning, this function might be slow [ O(M^2) where M = nb. neighbors ]
+   Copy the topology from EOND and EOSTC to SERENA.
+   The SERENA neighbor table is filled in EOND order, hence is sorted by
+   neighbor identifier, and children are found by identifier
+   [ O(M + C log M) where M = nb. neighbors, C = nb. children ]
 */
 int opera_set_serena_topology_info(opera_state_t* state,
 				   eostc_tree_t* tree)
@@ -59,6 +60,7 @@ int opera_set_serena_topology_info(opera_state_t* state,
       = &(serena_state->neighbor_table[serena_state->nb_neighbor]);
     serena_state->nb_neighbor ++;
     hipsens_address_copy(current_neigh->address, neighbor->address);
+    current_neigh->neighbor_id = (neighbor_id_t)i;
 
     if (hipsens_address_equal(neighbor->address, tree->parent_address)) {
       parent_count ++;
@@ -69,24 +71,25 @@ int opera_set_serena_topology_info(opera_state_t* state,
   }
   
   int unstability_count = 0;
-  for (j=0; j<MAX_NEIGHBOR; j++) { //XXX: could be more?
+  for (j=0; j<EOSTC_MAX_CHILD(serena_tree); j++) { //XXX: could be more?
     eostc_child_t* child = &serena_tree->child[j];
     if (child->status == Child_None)
       continue;
     if (child->status == Child_Unstable)
       unstability_count ++;
     
-    serena_neighbor_t* neighbor = NULL;
-    for (i=0;i<serena_state->nb_neighbor;i++)
-      if (hipsens_address_equal(serena_state->neighbor_table[i].address,
-				child->address))
-	neighbor = &serena_state->neighbor_table[i];
-    if (neighbor != NULL) {
-      neighbor->is_child = HIPSENS_TRUE;
+    int neighbor_index = serena_find_neighbor_index_by_id
+      (serena_state, child->neighbor_id);
+    if (neighbor_index >= 0) {
+      serena_state->neighbor_table[neighbor_index].is_child = HIPSENS_TRUE;
     } else unstability_count ++;
   }
 
   /* --- reset serena state */
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  hipsens_address_copy(state->colored_root_address, tree->root_address);
+  state->colored_tree_seq_num = serena_tree->tree_seq_num;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
   serena_state->is_started = HIPSENS_FALSE;
   serena_state->is_topology_set = HIPSENS_TRUE;
   serena_state->is_finished = HIPSENS_FALSE;
@@ -116,6 +119,10 @@ int opera_set_serena_topology_info(opera_state_t* state,
       priority = 0xff;
 #endif /* WITH_LONG_PRIORITY */
   SET_PRIORITY(serena_state->priority, priority);
+#ifdef WITH_OPERA_MULTI_SLOT
+  /* for the number of colors of the node */
+  serena_state->nb_descendant = eostc_count_descendant(eostc_state, tree);
+#endif /* WITH_OPERA_MULTI_SLOT */
   
   /* --- return */
 
@@ -129,6 +136,44 @@ int opera_set_serena_topology_info(opera_state_t* state,
 
 /*---------------------------------------------------------------------------*/
 
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+/* is the node colored, for the tree `tree' (which may then be repaired) ? */
+static hipsens_bool opera_is_tree_repairable(opera_state_t* state,
+					     eostc_tree_t* tree)
+{
+  return serena_is_colored(&state->serena_state)
+    && hipsens_address_equal(state->colored_root_address, tree->root_address)
+    && state->colored_tree_seq_num == tree->serena_info->tree_seq_num;
+}
+
+/* called on the root, when a local recoloring increased the max color */
+static void opera_on_max_color_increase(struct s_serena_state_t* state)
+{
+  opera_state_t* opera = (opera_state_t*) state->base->opaque_opera;
+  if (!opera->has_set_color)
+    return; /* will be given by opera_on_coloring_finished */
+  int nb_color = state->last_nb_color;
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  nb_color = serena_get_nb_channel_slot(state, nb_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+  hipsens_api_set_nb_color(opera->base_state.opaque_extra_info, nb_color);
+}
+
+void hipsens_notify_neighbor_appeared(base_state_t* base, address_t address,
+				      int neighbor_index, eostc_tree_t* tree)
+{
+  opera_state_t* opera = (opera_state_t*) base->opaque_opera;
+  serena_state_t* serena = &opera->serena_state;
+  if (!opera_is_tree_repairable(opera, tree))
+    return;
+  if (serena_find_neighbor_index(serena, address) >= 0)
+    return;
+  if (serena_add_neighbor(serena, address, (neighbor_id_t)neighbor_index) < 0)
+    return;
+  serena_start_repair(serena); /* the new neighbor will be colored */
+}
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
 void opera_on_coloring_finished(struct s_serena_state_t* state)
 {
   opera_state_t* opera = (opera_state_t*) state->base->opaque_opera;
@@ -140,13 +185,26 @@ void opera_on_coloring_finished(struct s_serena_state_t* state)
   if (nb_color == 0) {
     STWARN("opera_on_coloring_finished but no color available.\n");
   }
-  
+
+  if (nb_color > 0) /* used colors, nb. colors (or slots) of the tree */
+    nb_color = serena_set_tree_info(&opera->serena_state, nb_color);
+
   opera->has_set_color = (nb_color > 0);
   hipsens_api_set_nb_color(opera->base_state.opaque_extra_info, nb_color);
   hipsens_api_should_run_serena(opera->base_state.opaque_extra_info, 
 				HIPSENS_FALSE);
 }
 
+#ifdef WITH_OPERA_SLOT_ORDER
+int opera_get_sink_latency(opera_state_t* state)
+{
+  int latency = serena_get_subtree_latency(&state->serena_state);
+  if (latency < 0)
+    return -1;
+  return 1 + latency;
+}
+#endif /* WITH_OPERA_SLOT_ORDER */
+
 // XXX!! remove when beacons are used
 void opera_ensure_serena_stopped(eostc_state_t* state);
 void opera_ensure_serena_stopped(eostc_state_t* state)
@@ -167,15 +225,27 @@ void hipsens_eostc_event_my_tree_flags_change(eostc_state_t* state,
   /* the tree became stable: copy topology, update external state,
      and start SERENA */
   opera_state_t* opera = (opera_state_t*) state->base->opaque_opera;
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  if (opera->has_set_color && opera_is_tree_repairable(opera, tree))
+    return; /* the colors are kept, changes are repaired locally */
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
   opera_set_serena_topology_info(opera, tree);
 
   if (opera->has_set_color)
     return; /* we wait for an explicit re-coloring request (via serial cmd.) */
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  opera_central_start(opera, tree); /* collect the reports of the tree */
+#endif /* WITH_OPERA_CENTRAL_COLORING */
   
   hipsens_api_should_run_serena(opera->base_state.opaque_extra_info, 
 				HIPSENS_TRUE);
 
   opera->serena_state.callback_coloring_finished = &opera_on_coloring_finished;
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  opera->serena_state.callback_max_color_increase
+    = &opera_on_max_color_increase;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
 
   new__serena_start(&opera->serena_state); //ichrak
 }
@@ -194,6 +264,11 @@ void hipsens_eostc_event_tree_stability(eostc_state_t* state,
   
   ASSERT( IS_FOR_SERENA(*tree) );
 
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  if (opera_is_tree_repairable(opera, tree))
+    return; /* the colors are kept, changes are repaired locally */
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
   if (opera->serena_state.is_started && !opera->serena_state.is_finished) {
     /* SERENA is already running */
     int address_cmp = hipsens_address_cmp(opera->serena_state.root_address,
@@ -212,6 +287,9 @@ void hipsens_eostc_event_tree_stability(eostc_state_t* state,
   }
   
   opera_set_serena_topology_info(opera, tree);
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  opera_central_start(opera, tree); /* report the neighbors to the root */
+#endif /* WITH_OPERA_CENTRAL_COLORING */
 }
 
 hipsens_bool hipsens_is_tree_being_colored(eostc_state_t* state, 
@@ -243,7 +321,11 @@ void hipsens_notify_tree_change(base_state_t* base, address_t address,
 				hipsens_tristate is_child)
 {
   opera_state_t* opera = (opera_state_t*) base->opaque_opera;
-  if (!hipsens_is_tree_being_colored(&opera->eostc_state, tree))
+  if (!hipsens_is_tree_being_colored(&opera->eostc_state, tree)
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+      && !opera_is_tree_repairable(opera, tree)
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+      )
     return;
   int neighbor_index = serena_find_neighbor_index(&opera->serena_state,address);
   if (neighbor_index < 0)
@@ -313,6 +395,17 @@ void opera_external_notify_color_use(opera_state_t* state,
 				 serena->final_node_color,
 				 serena->final_nb_neighbor_color,
 				 serena->final_neighbor_color_list);
+#ifdef WITH_OPERA_MULTI_SLOT
+      hipsens_api_set_node_color_list(state->base_state.opaque_extra_info,
+				      serena->final_nb_node_color,
+				      serena->final_node_color_list);
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+      hipsens_api_set_channel_info(state->base_state.opaque_extra_info,
+				   serena->final_node_channel,
+				   serena->final_nb_neighbor_color,
+				   serena->final_neighbor_channel_list);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
     } else {
       STWARN("external_notify_color_use, but no colors are available.\n");
       hipsens_api_set_color_info(state->base_state.opaque_extra_info,
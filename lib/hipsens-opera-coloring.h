@@ -39,6 +39,13 @@ int opera_set_serena_topology_info(opera_state_t* state,
 
 void opera_on_coloring_finished(struct s_serena_state_t* state);
 
+#ifdef WITH_OPERA_SLOT_ORDER
+/** on the root: worst number of cycles for a packet from any node of the
+    colored tree to reach the root (1 + serena_get_subtree_latency),
+    -1 if not yet known */
+int opera_get_sink_latency(opera_state_t* state);
+#endif /* WITH_OPERA_SLOT_ORDER */
+
 /*---------------------------------------------------------------------------*/
 
 #endif /* _HIPSENS_OPERA_COLORING_H */
@@ -22,6 +22,8 @@
  * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA. 
  *---------------------------------------------------------------------------*/
 
+#include <string.h>
+
 #include "hipsens-all.h"
 
 /*---------------------------------------------------------------------------*/
@@ -90,6 +92,23 @@ void opera_config_init_default(opera_config_t* config)
 
   config->eond_start_delay = 0;
   config->eostc_start_delay = 0;
+  config->immediate_response = 0;
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+  /* Tree Status > STC > Color > Hello, no rate limitation */
+  int i;
+  for (i=0; i<OPERA_TX_CLASS_NB; i++) {
+    config->tx_class_config[i].bucket_size = 1;
+    config->tx_class_config[i].refill_interval = 0;
+  }
+  config->tx_class_config[OPERA_TX_TREE_STATUS].priority = 3;
+  config->tx_class_config[OPERA_TX_STC].priority = 2;
+  config->tx_class_config[OPERA_TX_COLOR].priority = 1;
+  config->tx_class_config[OPERA_TX_HELLO].priority = 0;
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  config->tx_class_config[OPERA_TX_CENTRAL].priority = 2;
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+#endif /* WITH_OPERA_TX_SCHEDULER */
 }
 
 void opera_update_wakeup_condition(opera_state_t* state);
@@ -107,11 +126,30 @@ static void opera_internal_init(opera_state_t* state)
   state->should_inc_colored_tree_seq = HIPSENS_FALSE;
   state->should_stop_stc_generation = HIPSENS_FALSE;
   state->has_set_color = HIPSENS_FALSE;
+  state->is_stopped = HIPSENS_FALSE;
+  state->should_process_when_stopped = HIPSENS_FALSE;
 
 #ifdef WITH_OPERA_ADDRESS_FILTER
   state->filter_nb_address = 0;
   state->filter_mode = FilterNone;
 #endif
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+  int i;
+  for (i=0; i<OPERA_TX_CLASS_NB; i++) {
+    state->tx_bucket[i].token_count = 0;
+    state->tx_bucket[i].refill_time = undefined_time; /* filled when used */
+  }
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  opera_central_init(&state->central_state);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  memset(state->colored_root_address, 0, ADDRESS_SIZE);
+  state->colored_tree_seq_num = 0;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
 }
 
 void opera_direct_init(opera_state_t* state, opera_config_t* config,
@@ -133,6 +171,102 @@ void opera_direct_init(opera_state_t* state, opera_config_t* config,
   opera_internal_init(state);
 }
 
+#ifdef WITH_OPERA_ARENA
+int opera_arena_size(opera_capacity_t* capacity)
+{
+  return OPERA_ARENA_SIZE(capacity->max_neighbor, capacity->max_stc_tree,
+			  capacity->max_stc_serena_tree);
+}
+
+/* returns the next `size' bytes of the arena, and advances `*arena_ptr' */
+static void* opera_arena_carve(byte** arena_ptr, int size)
+{
+  void* result = *arena_ptr;
+  (*arena_ptr) += OPERA_ARENA_ALIGN(size);
+  return result;
+}
+
+int opera_set_arena(opera_state_t* state, opera_capacity_t* capacity,
+		    void* arena)
+{
+  if (capacity->max_neighbor == 0 
+      || capacity->max_stc_tree <= capacity->max_stc_serena_tree)
+    return OPERA_ARENA_BAD_CAPACITY;
+
+  int max_neighbor = capacity->max_neighbor;
+  byte* arena_ptr = (byte*)arena;
+  memset(arena, 0, opera_arena_size(capacity));
+  state->arena = arena;
+  state->is_arena_owned = HIPSENS_FALSE;
+
+  /* the tables indexed by neighbor are kept together */
+  eond_state_t* eond = &state->eond_state;
+  eond->neighbor_table = (eond_neighbor_t*)opera_arena_carve
+    (&arena_ptr, max_neighbor * sizeof(eond_neighbor_t));
+  eond->max_neighbor = max_neighbor;
+
+  serena_state_t* serena = &state->serena_state;
+  serena->neighbor_table = (serena_neighbor_t*)opera_arena_carve
+    (&arena_ptr, max_neighbor * sizeof(serena_neighbor_t));
+  serena->final_neighbor_color_list = (byte*)opera_arena_carve
+    (&arena_ptr, max_neighbor * MAX_NODE_COLOR * sizeof(byte));
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  serena->final_neighbor_channel_list = (byte*)opera_arena_carve
+    (&arena_ptr, max_neighbor * MAX_NODE_COLOR * sizeof(byte));
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+  serena->max_neighbor = max_neighbor;
+
+  eostc_state_t* eostc = &state->eostc_state;
+  eostc->tree = (eostc_tree_t*)opera_arena_carve
+    (&arena_ptr, capacity->max_stc_tree * sizeof(eostc_tree_t));
+  eostc->max_tree = capacity->max_stc_tree;
+  eostc->serena_info = (eostc_serena_tree_t*)opera_arena_carve
+    (&arena_ptr, capacity->max_stc_serena_tree * sizeof(eostc_serena_tree_t));
+  eostc->max_serena_tree = capacity->max_stc_serena_tree;
+  int i;
+  for (i=0; i<capacity->max_stc_serena_tree; i++) {
+    eostc->serena_info[i].child = (eostc_child_t*)opera_arena_carve
+      (&arena_ptr, max_neighbor * sizeof(eostc_child_t));
+    eostc->serena_info[i].max_child = max_neighbor;
+  }
+
+  ASSERT( arena_ptr - (byte*)arena == opera_arena_size(capacity) );
+  return 0;
+}
+
+int opera_direct_init_with_capacity(opera_state_t* state,
+				    opera_config_t* config,
+				    opera_capacity_t* capacity, void* arena,
+				    hipsens_time_t current_time,
+				    void* opaque_extra_info)
+{
+  hipsens_bool is_arena_owned = HIPSENS_FALSE;
+  if (arena == NULL) {
+#ifdef IS_EMBEDDED
+    return OPERA_ARENA_NO_MEMORY;
+#else
+    arena = malloc(opera_arena_size(capacity));
+    if (arena == NULL)
+      return OPERA_ARENA_NO_MEMORY;
+    is_arena_owned = HIPSENS_TRUE;
+#endif
+  }
+
+  int result = opera_set_arena(state, capacity, arena);
+  if (result < 0) {
+#ifndef IS_EMBEDDED
+    if (is_arena_owned)
+      free(arena);
+#endif
+    return result;
+  }
+  state->is_arena_owned = is_arena_owned;
+
+  opera_direct_init(state, config, current_time, opaque_extra_info);
+  return 0;
+}
+#endif /* WITH_OPERA_ARENA */
+
 void opera_direct_start(opera_state_t* state, hipsens_time_t current_time)
 {
   state->base_state.current_time = current_time;
@@ -157,6 +291,187 @@ void opera_start_eostc(opera_state_t* state, hipsens_bool is_for_serena)
   eostc_start(&state->eostc_state, is_for_serena); 
 }
 
+/*---------------------------------------------------------------------------*/
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+
+/* time at which a message of the class should be generated, 
+   undefined_time if none */
+static hipsens_time_t opera_tx_get_class_time(opera_state_t* state,
+					      int tx_class)
+{
+  hipsens_time_t current_time = state->base_state.current_time;
+  int eond_delay = state->config->eond_start_delay;
+  int eostc_delay = state->config->eostc_start_delay;
+
+  switch (tx_class) {
+  case OPERA_TX_HELLO:
+    if (eond_delay != 0 && current_time < eond_delay)
+      return undefined_time;
+    return eond_get_next_hello_time(&state->eond_state);
+  case OPERA_TX_STC:
+    if (eostc_delay != 0 && current_time < eostc_delay)
+      return undefined_time;
+    return eostc_get_next_stc_time(&state->eostc_state);
+  case OPERA_TX_TREE_STATUS:
+    if (eostc_delay != 0 && current_time < eostc_delay)
+      return undefined_time;
+    return eostc_get_next_tree_status_time(&state->eostc_state);
+  case OPERA_TX_COLOR:
+    return serena_get_next_color_time(&state->serena_state);
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  case OPERA_TX_CENTRAL:
+    return opera_central_get_next_time(state);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+  default:
+    return undefined_time;
+  }
+}
+
+static void opera_tx_refill(opera_state_t* state, int tx_class)
+{
+  opera_tx_class_config_t* class_config 
+    = &state->config->tx_class_config[tx_class];
+  opera_tx_bucket_t* bucket = &state->tx_bucket[tx_class];
+  hipsens_time_t current_time = state->base_state.current_time;
+
+  if (bucket->refill_time == undefined_time
+      || HIPSENS_TIME_COMPARE_NO_UNDEF(current_time, <, bucket->refill_time)) {
+    /* first use (or the clock went back): full bucket */
+    bucket->token_count = class_config->bucket_size;
+    bucket->refill_time = current_time;
+    return;
+  }
+  if (class_config->refill_interval == 0)
+    return;
+
+  hipsens_time_t nb_token = (current_time - bucket->refill_time)
+    / class_config->refill_interval;
+  if (bucket->token_count + nb_token >= class_config->bucket_size) {
+    bucket->token_count = class_config->bucket_size;
+    bucket->refill_time = current_time;
+  } else {
+    bucket->token_count += nb_token;
+    bucket->refill_time += nb_token * class_config->refill_interval;
+  }
+}
+
+static hipsens_bool opera_tx_has_token(opera_state_t* state, int tx_class)
+{
+  opera_tx_refill(state, tx_class);
+  return state->config->tx_class_config[tx_class].refill_interval == 0
+    || state->tx_bucket[tx_class].token_count > 0;
+}
+
+static hipsens_bool opera_tx_is_ready(opera_state_t* state, int tx_class)
+{
+  hipsens_time_t class_time = opera_tx_get_class_time(state, tx_class);
+  return class_time != undefined_time
+    && HIPSENS_TIME_COMPARE_NO_UNDEF(class_time, <=, 
+				     state->base_state.current_time)
+    && opera_tx_has_token(state, tx_class);
+}
+
+static int opera_tx_generate(opera_state_t* state, int tx_class,
+			     byte* packet, int max_packet_size)
+{
+  int packet_size = 0;
+  PROFILE_BEGIN(profile_start);
+  switch (tx_class) {
+  case OPERA_TX_HELLO:
+    packet_size = eond_notify_wakeup(&state->eond_state,
+				     packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_EOND, profile_start);
+    break;
+  case OPERA_TX_STC:
+    packet_size = eostc_notify_wakeup_stc(&state->eostc_state,
+					  packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_EOSTC, profile_start);
+    break;
+  case OPERA_TX_TREE_STATUS:
+    packet_size = eostc_notify_wakeup_tree_status(&state->eostc_state,
+						  packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_EOSTC, profile_start);
+    break;
+  case OPERA_TX_COLOR:
+    packet_size = serena_notify_wakeup(&state->serena_state,
+				       packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
+    break;
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  case OPERA_TX_CENTRAL:
+    packet_size = opera_central_notify_wakeup(state, packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
+    break;
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+  }
+  return (packet_size > 0) ? packet_size : 0;
+}
+
+/* generates the message of the ready class with the highest priority */
+static int opera_tx_schedule(opera_state_t* state,
+			     byte* packet, int max_packet_size)
+{
+  if (packet == NULL)
+    return 0;
+
+  opera_tx_class_config_t* class_config = state->config->tx_class_config;
+  int tried_class_set = 0;
+  for (;;) {
+    int best_class = -1;
+    int i;
+    for (i=0; i<OPERA_TX_CLASS_NB; i++)
+      if ((tried_class_set & (1<<i)) == 0 && opera_tx_is_ready(state, i)
+	  && (best_class < 0
+	      || class_config[i].priority > class_config[best_class].priority))
+	best_class = i;
+    if (best_class < 0)
+      return 0;
+
+    tried_class_set |= (1<<best_class);
+    int packet_size = opera_tx_generate(state, best_class,
+					packet, max_packet_size);
+    if (packet_size > 0) {
+      if (class_config[best_class].refill_interval != 0)
+	state->tx_bucket[best_class].token_count --;
+      return packet_size;
+    }
+  }
+}
+
+/* when all the due messages are waiting for a token, the buffer wakeup is
+   postponed to the time of the next token (or of the next message) */
+static void opera_tx_update_wakeup_condition
+(opera_state_t* state, hipsens_wakeup_condition_t* condition)
+{
+  hipsens_time_t current_time = state->base_state.current_time;
+  if (HIPSENS_TIME_COMPARE_LARGE_UNDEF
+      (current_time, <, condition->wakeup_time_buffer))
+    return;
+
+  hipsens_time_t result = undefined_time;
+  int i;
+  for (i=0; i<OPERA_TX_CLASS_NB; i++) {
+    hipsens_time_t class_time = opera_tx_get_class_time(state, i);
+    if (class_time == undefined_time)
+      continue;
+    if (HIPSENS_TIME_COMPARE_NO_UNDEF(class_time, <=, current_time)) {
+      if (opera_tx_has_token(state, i))
+	return; /* can be sent now */
+      class_time = HIPSENS_TIME_ADD(state->tx_bucket[i].refill_time,
+			      state->config->tx_class_config[i].refill_interval);
+    }
+    if (result == undefined_time
+	|| HIPSENS_TIME_COMPARE_NO_UNDEF(class_time, <, result))
+      result = class_time;
+  }
+  condition->wakeup_time_buffer = result;
+}
+
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
+/*---------------------------------------------------------------------------*/
+
 /**
  * Returns the next time the OPERA node should be woken up by
  * the external caller (with the function opera_handle_event_wake_up)
@@ -189,32 +504,76 @@ static void internal_opera_get_next_wakeup_condition
 				     &additional_condition);
     wakeup_condition_update(condition, &additional_condition);
   }
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  additional_condition.wakeup_time = undefined_time;
+  additional_condition.wakeup_time_buffer = opera_central_get_next_time(state);
+  wakeup_condition_update(condition, &additional_condition);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+  opera_tx_update_wakeup_condition(state, condition);
+#endif /* WITH_OPERA_TX_SCHEDULER */
 }
 
 
-static hipsens_bool is_address_accepted(opera_state_t* state,
-					address_t address)
-{
 #ifdef WITH_OPERA_ADDRESS_FILTER
-  if (state->filter_mode == FilterNone)
-    return HIPSENS_TRUE;
 
-  if (state->filter_mode == FilterReject) {
-    int i;
-    for (i=0; i<state->filter_nb_address; i++) {
-      if (hipsens_address_equal(address, state->address_filter[i])) 
-	return HIPSENS_FALSE;
-    }
-    return HIPSENS_TRUE;
-  } else if (state->filter_mode == FilterOnlyAccept) {
-    int i;
-    for (i=0; i<state->filter_nb_address; i++) {
-      if (hipsens_address_equal(address, state->address_filter[i])) 
-	return HIPSENS_TRUE;
-    }
-    return HIPSENS_FALSE;
+/* returns the index of the first address of the filter which is not 
+   lower than `address' (binary search) */
+static int opera_address_filter_lower_bound(opera_state_t* state,
+					    address_t address)
+{
+  int low = 0;
+  int high = state->filter_nb_address;
+  while (low < high) {
+    int middle = (low + high) / 2;
+    if (hipsens_address_cmp(state->address_filter[middle], address) < 0)
+      low = middle + 1;
+    else high = middle;
   }
+  return low;
+}
+
+static hipsens_bool opera_address_filter_has(opera_state_t* state,
+					     address_t address)
+{
+  int i = opera_address_filter_lower_bound(state, address);
+  return (i < state->filter_nb_address
+	  && hipsens_address_equal(state->address_filter[i], address));
+}
+
+void opera_address_filter_reset(opera_state_t* state, int filter_mode)
+{
+  state->filter_mode = filter_mode;
+  state->filter_nb_address = 0;
+}
+
+int opera_address_filter_add(opera_state_t* state, address_t address)
+{
+  int i = opera_address_filter_lower_bound(state, address);
+  if (i < state->filter_nb_address
+      && hipsens_address_equal(state->address_filter[i], address))
+    return 0; /* already present */
+  if (state->filter_nb_address >= MAX_FILTER_ADDRESS)
+    return -1;
+  memmove(state->address_filter[i+1], state->address_filter[i],
+	  (state->filter_nb_address - i) * sizeof(address_t));
+  hipsens_address_copy(state->address_filter[i], address);
+  state->filter_nb_address++;
+  return 0;
+}
 
+#endif /* WITH_OPERA_ADDRESS_FILTER */
+
+static hipsens_bool is_address_accepted(opera_state_t* state,
+					address_t address)
+{
+#ifdef WITH_OPERA_ADDRESS_FILTER
+  if (state->filter_mode == FilterReject)
+    return !opera_address_filter_has(state, address);
+  else if (state->filter_mode == FilterOnlyAccept)
+    return opera_address_filter_has(state, address);
 #endif
   return HIPSENS_TRUE;
 }
@@ -238,23 +597,27 @@ static void opera_process_packet(opera_state_t* state,
 	FMT_HST, state->base->current_time);
 
 #define MSG_SHORT_HEADER_SIZE (2)
+#ifdef WITH_OPERA_ADDRESS_FILTER
+  /* all the messages of a packet have the same sender */
+  if (state->filter_mode != FilterNone 
+      && packet_size >= MSG_SHORT_HEADER_SIZE + ADDRESS_SIZE
+      && !is_address_accepted(state, packet_data + MSG_SHORT_HEADER_SIZE))
+    return;
+#endif /* WITH_OPERA_ADDRESS_FILTER */
+
   while (packet_size >= MSG_SHORT_HEADER_SIZE) {
     byte message_type = packet_data[0];
     byte message_size = packet_data[1];
     byte header_and_message_size = message_size + MSG_SHORT_HEADER_SIZE;
 
-#if defined(WITH_OPERA_ADDRESS_FILTER) || defined(WITH_INPACKET_LINK_STAT)
+#ifdef WITH_INPACKET_LINK_STAT
     if (packet_size >= 4) {
       buffer_t buffer;
       buffer_init(&buffer, packet_data+2, packet_size-2);
       address_t sender_address; 
       buffer_get_ADDRESS(&buffer, sender_address);
 
-#ifdef WITH_OPERA_ADDRESS_FILTER
-      if (!is_address_accepted(state, sender_address))
-	return;
-#endif /* WITH_OPERA_ADDRESS_FILTER */
-#ifdef WITH_INPACKET_LINK_STAT
+
       eond_neighbor_t* neighbor = eond_find_neighbor_by_address
 	(&state->eond_state, sender_address);
       if (neighbor != NULL) {
@@ -271,36 +634,67 @@ static void opera_process_packet(opera_state_t* state,
 	    | (count << stat_offset);
 	}
       }
-#endif /* WITH_INPACKET_LINK_STAT */
     }
-#endif
+#endif /* WITH_INPACKET_LINK_STAT */
+
+    STTRACE(OPERA_TRACE_PACKET_RECEIVED, message_type, 
+	    header_and_message_size, power);
 
     if (header_and_message_size > packet_size) {
       STWARN("bad message size, packet remain.=%d, msg size=%d\n, [%d]",
 	     packet_size, header_and_message_size, initial_packet_size);
+      STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
 		  return;
     }
 
 
+    /* a batch of Hello messages (opera_event_packets_received) is
+       applied before any other message: EOSTC and SERENA need an
+       up-to-date tree stability */
+    hipsens_bool is_batch_suspended = HIPSENS_FALSE;
+    if (message_type != HIPSENS_MSG_HELLO
+	&& state->eostc_state.is_topology_change_deferred) {
+      eostc_end_neighbor_change_batch(&state->eostc_state);
+      is_batch_suspended = HIPSENS_TRUE;
+    }
+
+    PROFILE_BEGIN(profile_start);
     if (message_type == HIPSENS_MSG_HELLO) {
       /* process a message hello */
       eond_process_hello_message(&(state->eond_state), packet_data, 
 				 header_and_message_size, power);
+      STPROFILE_END(OPERA_PROFILE_EOND, profile_start);
     } else if (message_type == HIPSENS_MSG_COLOR) {
       /* process a color message */
       serena_state_t* serena = &(state->serena_state);
       serena_process_message(serena, packet_data, header_and_message_size);
+      STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
     } else if (message_type == HIPSENS_MSG_STC) {
       /* process a stc message */
       eostc_process_stc_message(&(state->eostc_state), packet_data,
 				header_and_message_size);
+      STPROFILE_END(OPERA_PROFILE_EOSTC, profile_start);
     } else if (message_type == HIPSENS_MSG_TREE_STATUS) {
       /* process a tree status message */
       eostc_process_tree_status_message(&(state->eostc_state), packet_data,
 					header_and_message_size);
+      STPROFILE_END(OPERA_PROFILE_EOSTC, profile_start);
+#ifdef WITH_OPERA_CENTRAL_COLORING
+    } else if (message_type == HIPSENS_MSG_NEIGHBOR_REPORT) {
+      opera_central_process_report(state, packet_data,
+				   header_and_message_size);
+      STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
+    } else if (message_type == HIPSENS_MSG_COLOR_ASSIGNMENT) {
+      opera_central_process_assignment(state, packet_data,
+				       header_and_message_size);
+      STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
     } else {
       STWARN("unknown message type=%d\n", message_type);
+      STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     }
+    if (is_batch_suspended)
+      eostc_begin_neighbor_change_batch(&state->eostc_state);
 
     packet_data += header_and_message_size;
     packet_size -= header_and_message_size;
@@ -338,10 +732,20 @@ static hipsens_bool opera_handle_event(opera_state_t* state,
   } 
 
   int packet_size = 0;
+#ifdef WITH_OPERA_TX_SCHEDULER
+  packet_size = opera_tx_schedule(state, packet, max_packet_size);
+  if (packet_size > 0) {
+    STLOG(DBGsimmsg,",'event':'generate-packet', 'type':%d, 'time':"
+	  FMT_HST, packet[0], current_time);
+    FILL_TRANSMIT_BUFFER(transmit_buffer, packet_size, broadcast_address);
+  }
+#else /* WITH_OPERA_TX_SCHEDULER */
   int eond_delay = state->config->eond_start_delay;
   if (eond_delay == 0 || state->base_state.current_time >= eond_delay) {
+    PROFILE_BEGIN(profile_start);
     packet_size = eond_notify_wakeup(&(state->eond_state), 
 				     packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_EOND, profile_start);
   }
   if (packet_size > 0) {
     STLOG(DBGsimmsg,",'event':'generate-packet', 'type':'eond', 'time':"
@@ -353,8 +757,10 @@ static hipsens_bool opera_handle_event(opera_state_t* state,
 
   int eostc_delay = state->config->eostc_start_delay;
   if (eostc_delay == 0 || state->base_state.current_time >= eostc_delay) {
+    PROFILE_BEGIN(profile_start);
     packet_size = eostc_notify_wakeup(&(state->eostc_state),
 				      packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_EOSTC, profile_start);
   }
   if (packet_size > 0) {
     STLOG(DBGsimmsg,",'event':'generate-packet', 'type':'eostc', 'time':"
@@ -364,8 +770,12 @@ static hipsens_bool opera_handle_event(opera_state_t* state,
     max_packet_size = 0;
   }
 
-  packet_size = serena_notify_wakeup(&(state->serena_state),
-				     packet, max_packet_size);
+  {
+    PROFILE_BEGIN(profile_start);
+    packet_size = serena_notify_wakeup(&(state->serena_state),
+				       packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
+  }
   if (packet_size > 0) {
     STLOG(DBGsimmsg,",'event':'generate-packet', 'type':'serena', 'time':"
 	  FMT_HST, current_time);
@@ -373,10 +783,29 @@ static hipsens_bool opera_handle_event(opera_state_t* state,
     packet = NULL; /* reset just in case */
     max_packet_size = 0;
   }
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  {
+    PROFILE_BEGIN(profile_start);
+    packet_size = opera_central_notify_wakeup(state, packet, max_packet_size);
+    STPROFILE_END(OPERA_PROFILE_SERENA, profile_start);
+  }
+  if (packet_size > 0) {
+    STLOG(DBGsimmsg,",'event':'generate-packet', 'type':'central', 'time':"
+	  FMT_HST, current_time);
+    FILL_TRANSMIT_BUFFER(transmit_buffer, packet_size, broadcast_address);
+    packet = NULL; /* reset just in case */
+    max_packet_size = 0;
+  }
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+#endif /* WITH_OPERA_TX_SCHEDULER */
   opera_update_wakeup_condition(state);
 
   if (transmit_buffer != NULL && transmit_buffer->payload_size>0) {
     state->cycle_transmit_count ++;
+    STTRACE(OPERA_TRACE_PACKET_GENERATED, transmit_buffer->payload[0],
+	    transmit_buffer->payload_size, state->cycle_transmit_count);
+    STMETRIC_ADD(OPERA_METRIC_BYTES_SENT, transmit_buffer->payload_size);
     STLOG(DBGsimmsg>1, ", 'content':");
     STWRITE((DBGsimmsg>1), data_pywrite, transmit_buffer->payload, 
 	    transmit_buffer->payload_size);
@@ -472,9 +901,216 @@ static void opera_check_serena_start(opera_state_t* state)
 
 void opera_start(opera_state_t* state)
 {
+  if (state->is_stopped) {
+    /* resume: the clock was not advanced while stopped */
+    state->is_stopped = HIPSENS_FALSE;
+    opera_update_wakeup_condition(state);
+    return;
+  }
   opera_direct_start(state, 0);
 }
 
+void opera_stop(opera_state_t* state, hipsens_bool should_process_packet)
+{
+  state->is_stopped = HIPSENS_TRUE;
+  state->should_process_when_stopped = (should_process_packet != 0);
+}
+
+/*---------------------------------------------------------------------------*/
+
+static int opera_config_check_interval(hipsens_time_t interval,
+				       hipsens_time_t max_jitter_time,
+				       hipsens_time_t hold_time)
+{
+  if (interval <= 0 || interval <= max_jitter_time)
+    return OPERA_CONFIG_BAD_INTERVAL;
+  /* the hold time is advertised as a vtime (rounded up) */
+  if (hold_time >= 0 && (hold_time <= interval
+			 || vtime_to_hipsens_time(hipsens_time_to_vtime
+						  (hold_time)) <= interval))
+    return OPERA_CONFIG_BAD_HOLD_TIME;
+  return 0;
+}
+
+/* scales the delay until `*next_time' by new_interval/old_interval */
+static void opera_config_reschedule(hipsens_time_t* next_time,
+				    hipsens_time_t current_time,
+				    hipsens_time_t old_interval,
+				    hipsens_time_t new_interval)
+{
+  if (*next_time == undefined_time || old_interval == new_interval)
+    return;
+  if (old_interval <= 0) {
+    *next_time = HIPSENS_TIME_ADD(current_time, new_interval);
+    return;
+  }
+  hipsens_time_t delay = *next_time - current_time;
+  if (delay <= 0)
+    return; /* already due */
+  delay = (hipsens_time_t)(((long)delay * new_interval) / old_interval);
+  *next_time = HIPSENS_TIME_ADD(current_time, delay);
+}
+
+int opera_config_apply(opera_state_t* state, opera_config_t* new_config)
+{
+  opera_config_t* config = state->config;
+  hipsens_time_t current_time = state->base->current_time;
+  int status;
+
+  status = opera_config_check_interval
+    (new_config->eond_config.hello_interval,
+     new_config->eond_config.max_jitter_time,
+     new_config->eond_config.neigh_hold_time);
+  if (status < 0)
+    return status;
+  status = opera_config_check_interval
+    (new_config->eostc_config.stc_interval,
+     new_config->eostc_config.max_jitter_time,
+     new_config->eostc_config.tree_hold_time);
+  if (status < 0)
+    return status;
+  status = opera_config_check_interval
+    (new_config->serena_config.msg_color_interval,
+     new_config->serena_config.max_jitter_time, -1);
+  if (status < 0)
+    return status;
+  if (new_config->serena_config.msg_color_interval
+      < SERENA_MIN_COLOR_INTERVAL)
+    return OPERA_CONFIG_BAD_INTERVAL;
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  /* when only msg_color_interval is changed, the bounds follow it */
+  serena_config_t bound_config = new_config->serena_config;
+  hipsens_bool is_bound_derived =
+    (bound_config.msg_color_interval 
+     != config->serena_config.msg_color_interval
+     && bound_config.min_color_interval 
+     == config->serena_config.min_color_interval
+     && bound_config.max_color_interval 
+     == config->serena_config.max_color_interval);
+  if (is_bound_derived)
+    serena_config_set_color_interval_bounds(&bound_config);
+  status = opera_config_check_interval
+    (bound_config.min_color_interval, bound_config.max_jitter_time, -1);
+  if (status < 0)
+    return status;
+  if (bound_config.min_color_interval < SERENA_MIN_COLOR_INTERVAL
+      || bound_config.max_color_interval < bound_config.min_color_interval)
+    return OPERA_CONFIG_BAD_INTERVAL;
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  /* the same for the wait of the color assigned by the root */
+  hipsens_time_t central_timeout = new_config->serena_config.central_timeout;
+  if (new_config->serena_config.msg_color_interval
+      != config->serena_config.msg_color_interval
+      && central_timeout == config->serena_config.central_timeout)
+    central_timeout = SERENA_CENTRAL_TIMEOUT
+      (new_config->serena_config.msg_color_interval);
+  if (central_timeout <= 0)
+    return OPERA_CONFIG_BAD_INTERVAL;
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+  if (new_config->eond_config.eviction_policy > EOND_Eviction_OldestAsym
+      || (new_config->eostc_config.tree_eviction_policy
+	  > EOSTC_Eviction_NonColoredFirst)
+      || (new_config->eostc_config.child_eviction_policy
+	  > EOSTC_Eviction_NonColoredFirst))
+    return OPERA_CONFIG_BAD_POLICY;
+#ifdef WITH_OPERA_SLOT_ORDER
+  if (new_config->serena_config.slot_order > Slot_order_children_first)
+    return OPERA_CONFIG_BAD_POLICY;
+#endif /* WITH_OPERA_SLOT_ORDER */
+#ifdef WITH_OPERA_MULTI_SLOT
+  if (new_config->serena_config.nb_slot > MAX_NODE_COLOR)
+    return OPERA_CONFIG_BAD_NB_SLOT;
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  if (new_config->serena_config.nb_channel == 0)
+    return OPERA_CONFIG_BAD_NB_CHANNEL;
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  if (new_config->serena_config.conflict_distance < 2
+      || new_config->serena_config.conflict_distance > 3)
+    return OPERA_CONFIG_BAD_CONFLICT_DISTANCE;
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+#ifdef WITH_OPERA_TX_SCHEDULER
+  { /* a class with an empty bucket would never send */
+    int i;
+    for (i=0; i<OPERA_TX_CLASS_NB; i++)
+      if (new_config->tx_class_config[i].refill_interval != 0
+	  && new_config->tx_class_config[i].bucket_size == 0)
+	return OPERA_CONFIG_BAD_BUCKET;
+  }
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
+  opera_config_reschedule(&state->eond_state.next_msg_hello_time, 
+			  current_time, config->eond_config.hello_interval,
+			  new_config->eond_config.hello_interval);
+  opera_config_reschedule(&state->eostc_state.next_msg_stc_time, 
+			  current_time, config->eostc_config.stc_interval,
+			  new_config->eostc_config.stc_interval);
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  /* the current interval is scaled like msg_color_interval, within the
+     new bounds */
+  serena_state_t* serena_state = &state->serena_state;
+  hipsens_time_t color_interval = serena_state->color_interval;
+  if (config->serena_config.msg_color_interval > 0)
+    color_interval = (hipsens_time_t)
+      (((long)color_interval * new_config->serena_config.msg_color_interval)
+       / config->serena_config.msg_color_interval);
+  if (color_interval < bound_config.min_color_interval)
+    color_interval = bound_config.min_color_interval;
+  if (color_interval > bound_config.max_color_interval)
+    color_interval = bound_config.max_color_interval;
+  opera_config_reschedule(&serena_state->next_msg_color_time, 
+			  current_time, serena_state->color_interval,
+			  color_interval);
+  serena_state->color_interval = color_interval;
+#else /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+  opera_config_reschedule(&state->serena_state.next_msg_color_time, 
+			  current_time, config->serena_config.msg_color_interval,
+			  new_config->serena_config.msg_color_interval);
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  opera_config_reschedule(&state->serena_state.central_deadline,
+			  current_time, config->serena_config.central_timeout,
+			  central_timeout);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+  /* re-advertise the hold times (only if the generation was started) */
+  if (new_config->eond_config.neigh_hold_time 
+      != config->eond_config.neigh_hold_time
+      && state->eond_state.next_msg_hello_time != undefined_time)
+    state->eond_state.next_msg_hello_time = current_time;
+  if (new_config->eostc_config.tree_hold_time 
+      != config->eostc_config.tree_hold_time
+      && state->eostc_state.next_msg_stc_time != undefined_time)
+    state->eostc_state.next_msg_stc_time = current_time;
+
+#ifdef WITH_OPERA_SLOT_ORDER
+  hipsens_bool is_slot_order_changed = 
+    (new_config->serena_config.slot_order != config->serena_config.slot_order);
+#endif /* WITH_OPERA_SLOT_ORDER */
+
+  if (new_config != config)
+    *config = *new_config;
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  config->serena_config.min_color_interval = bound_config.min_color_interval;
+  config->serena_config.max_color_interval = bound_config.max_color_interval;
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  config->serena_config.central_timeout = central_timeout;
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+  if (is_slot_order_changed) /* recompute the final colors */
+    serena_set_tree_nb_color(&state->serena_state,
+			     state->serena_state.tree_nb_color);
+#endif /* WITH_OPERA_SLOT_ORDER */
+  opera_update_wakeup_condition(state);
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+
 void opera_inc_colored_tree_seq(opera_state_t* state);
 void opera_inc_colored_tree_seq(opera_state_t* state)
 {
@@ -509,13 +1145,23 @@ void opera_inc_colored_tree_seq(opera_state_t* state)
 #endif /* WITH_OPERA_SYSTEM_INFO */
 }
 
-hipsens_bool opera_event_new_cycle(opera_state_t* state, byte unused)
+/* `nb_cycle' is the number of cycles since the previous call (1 when
+   called at every cycle, see opera_event_new_cycles) */
+static hipsens_bool opera_internal_new_cycle(opera_state_t* state,
+					     hipsens_time_t nb_cycle)
 {
   if (state->is_blocked)
     return HIPSENS_FALSE;
+  PROFILE_BEGIN(profile_start);
   if (state->should_be_reset) {
     opera_init(state, state->config, state->base_state.opaque_extra_info);
     ASSERT( !state->should_be_reset );
+    STPROFILE_END(OPERA_PROFILE_NEW_CYCLE, profile_start);
+    return HIPSENS_FALSE;
+  }
+  if (state->is_stopped) {
+    /* the clock is not updated: this shifts all the timers */
+    STPROFILE_END(OPERA_PROFILE_NEW_CYCLE, profile_start);
     return HIPSENS_FALSE;
   }
   if (state->should_inc_colored_tree_seq)
@@ -528,18 +1174,23 @@ hipsens_bool opera_event_new_cycle(opera_state_t* state, byte unused)
   }
   
 
-  state->base->current_time++; /* update clock */
+  state->base->current_time += nb_cycle; /* update clock */
   STLOG(DBGsimmsg, ",'time':" FMT_HST, state->base->current_time);
 
   state->cycle_transmit_count = 0;
   opera_check_serena_start(state);
 
   /* wake up anyway */
-  if (state->wakeup_condition.wakeup_time == undefined_time
-      || state->wakeup_condition.wakeup_time == state->base->current_time) {
+  hipsens_time_t wakeup_time = state->wakeup_condition.wakeup_time;
+  if (wakeup_time == undefined_time
+      || wakeup_time == state->base->current_time
+      || (nb_cycle > 1 /* the caller may be late in tickless mode */
+	  && HIPSENS_TIME_COMPARE_NO_UNDEF
+	  (wakeup_time, <, state->base->current_time))) {
     opera_handle_event(state, state->base->current_time, NULL);
     opera_update_wakeup_condition(state);
   }
+  STPROFILE_END(OPERA_PROFILE_NEW_CYCLE, profile_start);
 
   int rate_limit = state->config->transmit_rate_limit;
   if (rate_limit !=0 && state->cycle_transmit_count >= rate_limit)
@@ -549,15 +1200,73 @@ hipsens_bool opera_event_new_cycle(opera_state_t* state, byte unused)
 	  <= state->base->current_time);
 }
 
+hipsens_bool opera_event_new_cycle(opera_state_t* state, byte unused)
+{ return opera_internal_new_cycle(state, 1); }
+
+/* keeps in `*result' the earliest of the times after `current_time' */
+static void opera_tickless_update(hipsens_time_t* result, 
+				  hipsens_time_t current_time,
+				  hipsens_time_t wakeup_time)
+{
+  if (wakeup_time == undefined_time)
+    return;
+  if (HIPSENS_TIME_COMPARE_NO_UNDEF(wakeup_time, <=, current_time))
+    wakeup_time = HIPSENS_TIME_ADD(current_time, 1);
+  if (*result == undefined_time 
+      || HIPSENS_TIME_COMPARE_NO_UNDEF(wakeup_time, <, *result))
+    *result = wakeup_time;
+}
+
+hipsens_time_t opera_get_cycles_until_wakeup(opera_state_t* state)
+{
+  if (state->is_blocked)
+    return OPERA_NO_WAKEUP;
+  if (state->should_be_reset)
+    return 1;
+  if (state->is_stopped)
+    return OPERA_NO_WAKEUP; /* until opera_start */
+  if (state->should_inc_colored_tree_seq
+      || state->should_stop_stc_generation || state->should_start_serena)
+    return 1; /* flags are processed at the beginning of a cycle */
+
+  hipsens_time_t current_time = state->base->current_time;
+  hipsens_time_t result = undefined_time;
+  opera_tickless_update(&result, current_time, 
+			state->wakeup_condition.wakeup_time);
+  opera_tickless_update(&result, current_time, 
+			state->wakeup_condition.wakeup_time_buffer);
+
+  /* the modules which are not started yet are not in the wakeup condition */
+  hipsens_time_t eond_delay = state->config->eond_start_delay;
+  if (eond_delay != 0 && current_time < eond_delay)
+    opera_tickless_update(&result, current_time, eond_delay);
+  hipsens_time_t eostc_delay = state->config->eostc_start_delay;
+  if (eostc_delay != 0 && current_time < eostc_delay)
+    opera_tickless_update(&result, current_time, eostc_delay);
+
+  if (result == undefined_time)
+    return OPERA_NO_WAKEUP;
+  return result - current_time;
+}
+
+hipsens_bool opera_event_new_cycles(opera_state_t* state,
+				    hipsens_time_t nb_cycle)
+{
+  ASSERT( nb_cycle >= 1 );
+  return opera_internal_new_cycle(state, nb_cycle);
+}
+
 hipsens_bool opera_event_wakeup_with_buffer
 (opera_state_t* state, transmit_buffer_t* transmit_buffer)
 {
-  if (state->is_blocked || state->should_be_reset)
+  if (state->is_blocked || state->should_be_reset || state->is_stopped)
     return HIPSENS_FALSE;
 
+  PROFILE_BEGIN(profile_start);
   opera_check_serena_start(state);
   opera_handle_event(state, state->base->current_time, transmit_buffer);
   opera_update_wakeup_condition(state);
+  STPROFILE_END(OPERA_PROFILE_WAKEUP_WITH_BUFFER, profile_start);
 
   int rate_limit = state->config->transmit_rate_limit;
   if (rate_limit !=0 && state->cycle_transmit_count >= rate_limit)
@@ -567,25 +1276,56 @@ hipsens_bool opera_event_wakeup_with_buffer
 	  == state->base->current_time);
 }
 
+/* by default, we only transmit at the beginning of the cycle */
+static hipsens_bool opera_should_respond_immediately(opera_state_t* state)
+{
+  if (!state->config->immediate_response
+      || state->is_blocked || state->should_be_reset || state->is_stopped)
+    return HIPSENS_FALSE;
+
+  int rate_limit = state->config->transmit_rate_limit;
+  if (rate_limit !=0 && state->cycle_transmit_count >= rate_limit)
+    return HIPSENS_FALSE;
+
+  return (state->wakeup_condition.wakeup_time_buffer 
+	  == state->base->current_time);
+}
+
 hipsens_bool opera_event_packet_received
 (opera_state_t* state, byte* packet_data, int packet_size, hipsens_u8 rssi)
 {
+  if (state->is_stopped && !state->should_process_when_stopped)
+    return HIPSENS_FALSE;
+  PROFILE_BEGIN(profile_start);
   opera_check_serena_start(state);
   //opera_handle_event(state, state->base->current_time, NULL);
   opera_process_packet(state, packet_data, packet_size, rssi);
   opera_update_wakeup_condition(state);
+  STPROFILE_END(OPERA_PROFILE_PACKET_RECEIVED, profile_start);
 
-  // XXX: we only transmit at the beginning of the cycle for now
-  return HIPSENS_FALSE;
+  return opera_should_respond_immediately(state);
+}
 
-#if 0  
-  int rate_limit = state->config->transmit_rate_limit;
-  if (rate_limit !=0 && state->cycle_transmit_count >= rate_limit)
+hipsens_bool opera_event_packets_received
+(opera_state_t* state, received_packet_t* packet_list, int nb_packet)
+{
+  int i;
+  if (state->is_stopped && !state->should_process_when_stopped)
     return HIPSENS_FALSE;
+  PROFILE_BEGIN(profile_start);
+  opera_check_serena_start(state);
+  eostc_begin_neighbor_change_batch(&state->eostc_state);
+  for (i=0; i<nb_packet; i++) {
+    received_packet_t* packet = &packet_list[i];
+    /* the batch is suspended for the non-Hello messages */
+    opera_process_packet(state, packet->packet_data, packet->packet_size,
+			 packet->rssi);
+  }
+  eostc_end_neighbor_change_batch(&state->eostc_state);
+  opera_update_wakeup_condition(state);
+  STPROFILE_END(OPERA_PROFILE_PACKET_RECEIVED, profile_start);
 
-  return (state->wakeup_condition.wakeup_time_buffer 
-	  == state->base->current_time);
-#endif
+  return opera_should_respond_immediately(state);
 }
 
 void opera_update_wakeup_condition(opera_state_t* state)
@@ -599,6 +1339,13 @@ void opera_close(opera_state_t* state)
   eond_close(&state->eond_state);
   eostc_close(&state->eostc_state);
 #endif
+#if defined(WITH_OPERA_ARENA) && !defined(IS_EMBEDDED)
+  if (state->is_arena_owned) {
+    free(state->arena);
+    state->arena = NULL;
+    state->is_arena_owned = HIPSENS_FALSE;
+  }
+#endif
 }
 
 
@@ -758,6 +1505,12 @@ void opera_write_size(outstream_t out)
 //	 sizeof( ((eostc_state_t*)(0))->tree[0].child) * MAX_STC_TREE,
 //	 MAX_STC_TREE, sizeof( ((eostc_state_t*)(0))->tree[0].child));
 
+#ifdef WITH_OPERA_ARENA
+  FPRINTF(out, "- arena (tables, with the above maximum values): %d\n",
+	  (int)OPERA_ARENA_SIZE(MAX_NEIGHBOR, MAX_STC_TREE,
+				MAX_STC_SERENA_TREE));
+#endif /* WITH_OPERA_ARENA */
+
   FPRINTF(out, "\n");
   FPRINTF(out, "->Full node with Neighbor Discovery + Strategic Tree + SERENA + 1 packet buff.:\n");
   FPRINTF(out, "    "); FPRINTF_SIZEOF(out, opera_state_t); printf("\n");
@@ -769,7 +1522,9 @@ void opera_write_size(outstream_t out)
 
 /*---------------------------------------------------------------------------*/
 
-#define OPERA_SERIAL_VERSION 0x00 // v0.0
+/* v0.1: the addresses of the address filter commands are ADDRESS_SIZE 
+   bytes (2 bytes in v0.0) */
+#define OPERA_SERIAL_VERSION 0x01 // v0.1
 
 typedef enum {
   OPERA_CMD_NONE = 0x00,
@@ -778,6 +1533,8 @@ typedef enum {
   OPERA_CMD_GET_BLOCKED = 0x03,
   OPERA_CMD_RESET = 0x04,
   OPERA_CMD_SET_ENERGY_CLASS = 0x05,
+  OPERA_CMD_STOP = 0x06,
+  OPERA_CMD_START = 0x07,
 
 
   OPERA_SET_EOND_HELLO_INTERVAL = 0x10,
@@ -792,6 +1549,9 @@ typedef enum {
   OPERA_SET_ENERGY_CLASS = 0x16,
   OPERA_GET_ENERGY_CLASS = 0x17,
 
+  OPERA_SET_EOND_EVICTION_POLICY = 0x18,
+  OPERA_GET_EOND_EVICTION_POLICY = 0x19,
+
   OPERA_SET_EOSTC_STC_INTERVAL = 0x20,
   OPERA_GET_EOSTC_STC_INTERVAL = 0x21,
 
@@ -816,14 +1576,50 @@ typedef enum {
 
   OPERA_SET_SERENA_COLOR_INTERVAL = 0x30,
   OPERA_GET_SERENA_COLOR_INTERVAL = 0x31,
+  OPERA_SET_SERENA_CENTRAL_COLORING = 0x32,
+  OPERA_GET_SERENA_CENTRAL_COLORING = 0x33,
+  OPERA_SET_SERENA_SLOT_ORDER = 0x34,
+  OPERA_GET_SERENA_SLOT_ORDER = 0x35,
+  OPERA_GET_SINK_LATENCY = 0x36,
+  OPERA_SET_SERENA_NB_SLOT = 0x37,
+  OPERA_GET_SERENA_NB_SLOT = 0x38,
+  OPERA_SET_SERENA_DESCENDANT_PER_SLOT = 0x39,
+  OPERA_GET_SERENA_DESCENDANT_PER_SLOT = 0x3a,
+  OPERA_SET_SERENA_NB_CHANNEL = 0x3b,
+  OPERA_GET_SERENA_NB_CHANNEL = 0x3c,
+  OPERA_SET_SERENA_CONFLICT_DISTANCE = 0x3d,
+  OPERA_GET_SERENA_CONFLICT_DISTANCE = 0x3e,
 
   OPERA_SET_TRANSMIT_RATE_LIMIT = 0x40,
   OPERA_GET_TRANSMIT_RATE_LIMIT = 0x41,
 
+  OPERA_SET_IMMEDIATE_RESPONSE = 0x42,
+  OPERA_GET_IMMEDIATE_RESPONSE = 0x43,
+
+  OPERA_SET_SERENA_MAX_SUPPRESSED = 0x44,
+  OPERA_GET_SERENA_MAX_SUPPRESSED = 0x45,
+  OPERA_SET_SERENA_MIN_COLOR_INTERVAL = 0x46,
+  OPERA_GET_SERENA_MIN_COLOR_INTERVAL = 0x47,
+  OPERA_SET_SERENA_MAX_COLOR_INTERVAL = 0x48,
+  OPERA_GET_SERENA_MAX_COLOR_INTERVAL = 0x49,
+  OPERA_SET_TX_CLASS = 0x4a,
+  OPERA_GET_TX_CLASS = 0x4b,
+  OPERA_SET_EOSTC_TREE_EVICTION_POLICY = 0x4c,
+  OPERA_GET_EOSTC_TREE_EVICTION_POLICY = 0x4d,
+  OPERA_SET_EOSTC_CHILD_EVICTION_POLICY = 0x4e,
+  OPERA_GET_EOSTC_CHILD_EVICTION_POLICY = 0x4f,
+
   OPERA_ADDRESS_FILTER_SET = 0x50,
   OPERA_ADDRESS_FILTER_GET = 0x51,
+  OPERA_ADDRESS_FILTER_ADD = 0x52,
+
+  OPERA_AYT = 0x60,
 
-  OPERA_AYT = 0x60
+  OPERA_GET_TRACE = 0x70,
+  OPERA_GET_METRICS = 0x71,
+  OPERA_RESET_METRICS = 0x72,
+  OPERA_GET_PROFILE = 0x73,
+  OPERA_RESET_PROFILE = 0x74
 } opera_cmd_t;
 
 #define GET_U16(uptr) ( (((unsigned short)(uptr[0])) << 8)	\
@@ -838,6 +1634,26 @@ typedef enum {
   COMMAND_SET_U16(cmd_code_set, name)					\
   COMMAND_GET_U16(cmd_code_get, name)
 
+/* same as COMMAND_SET_GET_U16, for a field `name' of opera_config_t
+   (through opera_config_apply) */
+#define COMMAND_APPLY_GET_U16(cmd_code_set, cmd_code_get, name)		\
+  COMMAND_APPLY_U16(cmd_code_set, name)					\
+  COMMAND_GET_U16(cmd_code_get, opera_cfg->name)
+
+#define COMMAND_APPLY_U16(cmd_code_set, name)				\
+  case (cmd_code_set): {						\
+    if (payload_length < 2) {						\
+      *result_code = 0xff;						\
+      return 0;								\
+    }									\
+    opera_config_t new_config = *opera_cfg;				\
+    new_config.name = GET_U16((payload+1));				\
+    if (opera_config_apply(state, &new_config) < 0)			\
+      *result_code = 0xfe;						\
+    else *result_code = 0;						\
+    return 0;								\
+  }
+
 #define COMMAND_SET_U16(cmd_code_set, name)				\
   case (cmd_code_set): {						\
     if (payload_length < 2) {						\
@@ -912,52 +1728,179 @@ byte opera_serial_command(
     *result_code = (state->is_blocked != 0);
     return 0;
   }
+  case OPERA_CMD_STOP: {
+    /* optional argument: should received packets be processed */
+    opera_stop(state, payload_length >= 2 && payload[1] != 0);
+    *result_code = (state->is_stopped != 0);
+    return 0;
+  }
+  case OPERA_CMD_START: {
+    if (!state->is_stopped) {
+      *result_code = 0xffu; /* only resuming is allowed */
+      return 0;
+    }
+    opera_start(state);
+    *result_code = (state->is_stopped != 0);
+    return 0;
+  }
   case OPERA_CMD_RESET: {
     state->should_be_reset = HIPSENS_TRUE;
     *result_code = 0xCA;
     return 0;
   }
   
-  COMMAND_SET_GET_U16(OPERA_SET_EOND_HELLO_INTERVAL,
-		      OPERA_GET_EOND_HELLO_INTERVAL,
-		      opera_cfg->eond_config.hello_interval);
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOND_HELLO_INTERVAL,
+		        OPERA_GET_EOND_HELLO_INTERVAL,
+		        eond_config.hello_interval);
+
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOND_NEIGH_HOLD_TIME,
+		        OPERA_GET_EOND_NEIGH_HOLD_TIME,
+		        eond_config.neigh_hold_time);
 
-  COMMAND_SET_GET_U16(OPERA_SET_EOND_NEIGH_HOLD_TIME,
-		      OPERA_GET_EOND_NEIGH_HOLD_TIME,
-		      opera_cfg->eond_config.neigh_hold_time);
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOND_EVICTION_POLICY,
+		        OPERA_GET_EOND_EVICTION_POLICY,
+		        eond_config.eviction_policy);
 
   COMMAND_SET_GET_U16(OPERA_SET_EOND_START_DELAY,
 		      OPERA_GET_EOND_START_DELAY,
 		      opera_cfg->eond_start_delay);
 
 
-  COMMAND_SET_GET_U16(OPERA_SET_EOSTC_STC_INTERVAL,
-		      OPERA_GET_EOSTC_STC_INTERVAL,
-		      opera_cfg->eostc_config.stc_interval);
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOSTC_STC_INTERVAL,
+		        OPERA_GET_EOSTC_STC_INTERVAL,
+		        eostc_config.stc_interval);
 
-  COMMAND_SET_GET_U16(OPERA_SET_EOSTC_TREE_HOLD_TIME,
-		      OPERA_GET_EOSTC_TREE_HOLD_TIME,
-		      opera_cfg->eostc_config.tree_hold_time);
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOSTC_TREE_HOLD_TIME,
+		        OPERA_GET_EOSTC_TREE_HOLD_TIME,
+		        eostc_config.tree_hold_time);
 
   COMMAND_SET_GET_U16(OPERA_SET_EOSTC_STABILITY_TIME,
 		      OPERA_GET_EOSTC_STABILITY_TIME,
 		      opera_cfg->eostc_config.stability_time);
 
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOSTC_TREE_EVICTION_POLICY,
+		        OPERA_GET_EOSTC_TREE_EVICTION_POLICY,
+		        eostc_config.tree_eviction_policy);
+
+  COMMAND_APPLY_GET_U16(OPERA_SET_EOSTC_CHILD_EVICTION_POLICY,
+		        OPERA_GET_EOSTC_CHILD_EVICTION_POLICY,
+		        eostc_config.child_eviction_policy);
+
 
   COMMAND_SET_GET_U16(OPERA_SET_EOSTC_START_DELAY,
 		      OPERA_GET_EOSTC_START_DELAY,
 		      opera_cfg->eostc_start_delay);
 
 
-  COMMAND_SET_GET_U16(OPERA_SET_SERENA_COLOR_INTERVAL,
-		      OPERA_GET_SERENA_COLOR_INTERVAL,
-		      opera_cfg->serena_config.msg_color_interval);
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_COLOR_INTERVAL,
+		        OPERA_GET_SERENA_COLOR_INTERVAL,
+		        serena_config.msg_color_interval);
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  COMMAND_SET_GET_U16(OPERA_SET_SERENA_CENTRAL_COLORING,
+		      OPERA_GET_SERENA_CENTRAL_COLORING,
+		      opera_cfg->serena_config.central_coloring);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_SLOT_ORDER,
+		        OPERA_GET_SERENA_SLOT_ORDER,
+		        serena_config.slot_order);
+
+  COMMAND_GET_U16(OPERA_GET_SINK_LATENCY,
+		  (hipsens_u16) opera_get_sink_latency(state));
+#endif /* WITH_OPERA_SLOT_ORDER */
+
+#ifdef WITH_OPERA_MULTI_SLOT
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_NB_SLOT,
+		        OPERA_GET_SERENA_NB_SLOT,
+		        serena_config.nb_slot);
+
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_DESCENDANT_PER_SLOT,
+		        OPERA_GET_SERENA_DESCENDANT_PER_SLOT,
+		        serena_config.nb_descendant_per_slot);
+#endif /* WITH_OPERA_MULTI_SLOT */
+
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_NB_CHANNEL,
+		        OPERA_GET_SERENA_NB_CHANNEL,
+		        serena_config.nb_channel);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_CONFLICT_DISTANCE,
+		        OPERA_GET_SERENA_CONFLICT_DISTANCE,
+		        serena_config.conflict_distance);
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_MAX_SUPPRESSED,
+		        OPERA_GET_SERENA_MAX_SUPPRESSED,
+		        serena_config.max_suppressed_color);
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_MIN_COLOR_INTERVAL,
+		        OPERA_GET_SERENA_MIN_COLOR_INTERVAL,
+		        serena_config.min_color_interval);
+  COMMAND_APPLY_GET_U16(OPERA_SET_SERENA_MAX_COLOR_INTERVAL,
+		        OPERA_GET_SERENA_MAX_COLOR_INTERVAL,
+		        serena_config.max_color_interval);
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+  case OPERA_SET_TX_CLASS: {
+    /* payload: class (opera_tx_class_t), priority, bucket_size,
+       refill_interval (u16) */
+    if (payload_length < 6) {
+      *result_code = 0xffu;
+      return 0;
+    }
+    if (payload[1] >= OPERA_TX_CLASS_NB) {
+      *result_code = 0xf1u;
+      return 0;
+    }
+    opera_config_t new_config = *opera_cfg;
+    opera_tx_class_config_t* class_config 
+      = &new_config.tx_class_config[payload[1]];
+    class_config->priority = payload[2];
+    class_config->bucket_size = payload[3];
+    class_config->refill_interval = GET_U16((payload+4));
+    if (opera_config_apply(state, &new_config) < 0)
+      *result_code = 0xfe;
+    else *result_code = 0;
+    return 0;
+  }
+
+  case OPERA_GET_TX_CLASS: {
+    /* payload: class ; result: priority, bucket_size, refill_interval (u16) */
+    if (payload_length < 2) {
+      *result_code = 0xffu;
+      return 0;
+    }
+    if (payload[1] >= OPERA_TX_CLASS_NB) {
+      *result_code = 0xf1u;
+      return 0;
+    }
+    opera_tx_class_config_t* class_config
+      = &opera_cfg->tx_class_config[payload[1]];
+    result_array[0] = class_config->priority;
+    result_array[1] = class_config->bucket_size;
+    PUT_U16((result_array+2), class_config->refill_interval);
+    *result_code = 0;
+    return 4;
+  }
+#endif /* WITH_OPERA_TX_SCHEDULER */
 
 
   COMMAND_SET_GET_U16(OPERA_SET_TRANSMIT_RATE_LIMIT,
 		      OPERA_GET_TRANSMIT_RATE_LIMIT,
 		      opera_cfg->transmit_rate_limit);
 
+  COMMAND_SET_GET_U16(OPERA_SET_IMMEDIATE_RESPONSE,
+		      OPERA_GET_IMMEDIATE_RESPONSE,
+		      opera_cfg->immediate_response);
+
 
   COMMAND_SET_GET_U16(OPERA_SET_ENERGY_CLASS,
 		      OPERA_GET_ENERGY_CLASS,
@@ -1031,39 +1974,144 @@ byte opera_serial_command(
 
 #ifdef WITH_OPERA_ADDRESS_FILTER
 #warning "[CA] compiled with address filters"
-  case OPERA_ADDRESS_FILTER_SET: {
+  case OPERA_ADDRESS_FILTER_SET:
+  case OPERA_ADDRESS_FILTER_ADD: {
+    /* SET: mode, address list ; ADD: address list (for bulk loading) ;
+       result: total(2) */
     if (payload_length < 2) {
       *result_code = 0xffu;
       return 0;
     }
-    if (payload[1] != 0 && payload[1] != 1 && payload[1] != 2) {
-      *result_code = 0xfeu;
-      return 0;
+    if (payload[0] == OPERA_ADDRESS_FILTER_SET) {
+      if (payload[1] != 0 && payload[1] != 1 && payload[1] != 2) {
+	*result_code = 0xfeu;
+	return 0;
+      }
+      opera_address_filter_reset(state, payload[1]);
+      payload ++;
+      payload_length --;
     }
-    state->filter_mode = payload[1];
-    state->filter_nb_address = 0;
-    payload +=2 ;
-    payload_length -= 2;
-    while (state->filter_nb_address < MAX_FILTER_ADDRESS
-	   && payload_length >= 2) {
-      state->address_filter[state->filter_nb_address][0] = payload[0];
-      state->address_filter[state->filter_nb_address][1] = payload[1];
-      state->filter_nb_address++;
-      payload += 2;
-      payload_length -= 2;
+    payload ++;
+    payload_length --;
+    while (payload_length >= ADDRESS_SIZE) {
+      if (opera_address_filter_add(state, payload) < 0) {
+	*result_code = 0xfdu; /* full */
+	return 0;
+      }
+      payload += ADDRESS_SIZE;
+      payload_length -= ADDRESS_SIZE;
     }
-    *result_code = state->filter_nb_address;
-    return 0;
+    *result_code = 0;
+    PUT_U16(result_array, state->filter_nb_address);
+    return 2;
   }
-#if 0
   case OPERA_ADDRESS_FILTER_GET: {
-    if (state->filter_nb_address * 2 >= max_result_size) {
+    /* payload: index(2) ; result: mode, total(2), addresses from index */
+    if (payload_length < 3) {
       *result_code = 0xffu;
       return 0;
     }
+    int i = GET_U16((payload+1));
+    buffer_t buffer;
+    buffer_init(&buffer, result_array, max_result_size);
+    buffer_put_u8(&buffer, state->filter_mode);
+    buffer_put_u16(&buffer, state->filter_nb_address);
+    int nb_address = 0;
+    while (i < state->filter_nb_address
+	   && buffer_remaining(&buffer) >= ADDRESS_SIZE) {
+      buffer_put_ADDRESS(&buffer, state->address_filter[i]);
+      i++;
+      nb_address++;
+    }
+    *result_code = nb_address;
+    return buffer.pos;
   }
 #endif
-#endif
+
+#ifdef WITH_OPERA_TRACE
+  case OPERA_GET_TRACE: {
+    /* payload: sequence number of the first record wanted ;
+       result: a trace block (see base_state_trace_dump) */
+    if (payload_length < 3) {
+      *result_code = 0xffu;
+      return 0;
+    }
+    hipsens_u16 seq_num = GET_U16((payload+1));
+    int result_size = base_state_trace_dump(state->base, &seq_num,
+					    result_array, max_result_size);
+    if (result_size < 0) {
+      *result_code = 0xf1u;
+      return 0;
+    }
+    *result_code = result_array[OPERA_TRACE_HEADER_SIZE-1]; /* nb-record */
+    return result_size;
+  }
+#endif /* WITH_OPERA_TRACE */
+
+#ifdef WITH_OPERA_METRICS
+  case OPERA_GET_METRICS: {
+    /* payload: index of the first counter wanted (opera_metric_t) ;
+       result: as many consecutive counters (u32) as fit in the result */
+    if (payload_length < 2) {
+      *result_code = 0xffu;
+      return 0;
+    }
+    int first = payload[1];
+    if (first >= OPERA_METRIC_NB) {
+      *result_code = 0xf1u;
+      return 0;
+    }
+    buffer_t buffer;
+    buffer_init(&buffer, result_array, max_result_size);
+    int i;
+    for (i = first; i < OPERA_METRIC_NB 
+	   && buffer_remaining(&buffer) >= 4; i++)
+      buffer_put_u32(&buffer, base_state_get_metric
+		     (state->base, (opera_metric_t)i));
+    *result_code = i - first;
+    return buffer.pos;
+  }
+
+  case OPERA_RESET_METRICS: {
+    base_state_reset_metrics(state->base);
+    *result_code = 0;
+    return 0;
+  }
+#endif /* WITH_OPERA_METRICS */
+
+#ifdef WITH_OPERA_PROFILE
+  case OPERA_GET_PROFILE: {
+    /* payload: profile point (opera_profile_point_t), first bucket ;
+       result: max duration (u32) then as many consecutive bucket
+       counters (u16) as fit in the result */
+    if (payload_length < 3) {
+      *result_code = 0xffu;
+      return 0;
+    }
+    profile_histogram_t* histogram = base_state_get_profile
+      (state->base, (opera_profile_point_t)payload[1]);
+    int first = payload[2];
+    if (histogram == NULL || first >= OPERA_PROFILE_NB_BUCKET) {
+      *result_code = 0xf1u;
+      return 0;
+    }
+    buffer_t buffer;
+    buffer_init(&buffer, result_array, max_result_size);
+    buffer_put_u32(&buffer, histogram->max_duration);
+    int i;
+    for (i = first; i < OPERA_PROFILE_NB_BUCKET
+	   && buffer_remaining(&buffer) >= 2; i++)
+      buffer_put_u16(&buffer, histogram->count[i]);
+    *result_code = i - first;
+    return buffer.pos;
+  }
+
+  case OPERA_RESET_PROFILE: {
+    base_state_reset_profile(state->base);
+    *result_code = 0;
+    return 0;
+  }
+#endif /* WITH_OPERA_PROFILE */
 
   default:
     *result_code = 0xf0u;
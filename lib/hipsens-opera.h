@@ -44,6 +44,8 @@
    opera_config_init_default(&opera_config);
    opera_init(&opera, &opera_config, NULL);
    opera_start(&opera); -- reset state and start generating packets
+   (with WITH_OPERA_CENTRAL_COLORING, the root also calls once
+    opera_central_set_graph(&opera, &opera_central_graph);)
 
    -- main event loop usage --
    BOOLEAN shouldSendPacket = opera_event_new_cycle(&opera, ...);
@@ -73,8 +75,7 @@ XXX: TODO
   façon est faite en doublon dans opera_init) ; l'initialisation
   se fera forcément par opera_init (ou bien aussi par une function `opera_reset'
   qui pourrait faire la même chose)
-- ajouter une function `opera_stop' (ce qui correspond à ne plus générer de
-  messages, mais éventuellement de pouvoir traiter des messages?)
+- [fait: `opera_stop', cas 1) ci-dessous]
 
 - implémenter la logique de telle façon que l'utilisation normale soit:
   . opera_config_init_default (fait une fois lors du boot)
@@ -115,6 +116,7 @@ XXX: TODO
 #include "hipsens-eond.h"
 #include "hipsens-eostc.h"
 #include "hipsens-oserena.h"
+#include "hipsens-central-coloring.h"
 #include "hipsens-external-api.h"
 
 /*---------------------------------------------------------------------------*/
@@ -122,6 +124,41 @@ XXX: TODO
 //#warning "[CA] undef OPERA_ADDRESS_FILTER"
 #define WITH_OPERA_ADDRESS_FILTER
 
+#ifdef WITH_OPERA_TX_SCHEDULER
+
+/** Classes of generated messages, for the transmit scheduler */
+typedef enum {
+  OPERA_TX_HELLO = 0,
+  OPERA_TX_STC = 1,
+  OPERA_TX_TREE_STATUS = 2,
+  OPERA_TX_COLOR = 3,
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  OPERA_TX_CENTRAL = 4, /**< Neighbor Report and Color Assignment */
+  OPERA_TX_CLASS_NB = 5
+#else /* WITH_OPERA_CENTRAL_COLORING */
+  OPERA_TX_CLASS_NB = 4
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+} opera_tx_class_t;
+
+/**
+ * When a buffer is offered, the message of the pending class with the
+ * highest `priority' is generated, provided its token bucket is not empty.
+ * One token is added every `refill_interval' cycles, up to `bucket_size'
+ * (refill_interval == 0: no rate limitation for the class).
+ */
+typedef struct s_opera_tx_class_config_t {
+  hipsens_u8 priority;
+  hipsens_u8 bucket_size;
+  hipsens_u16 refill_interval;
+} opera_tx_class_config_t;
+
+typedef struct s_opera_tx_bucket_t {
+  hipsens_u8 token_count;
+  hipsens_time_t refill_time; /**< time of the last token added */
+} opera_tx_bucket_t;
+
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
 /** XXX: in construction */
 typedef struct s_opera_config_t {
   eond_config_t   eond_config;
@@ -131,8 +168,54 @@ typedef struct s_opera_config_t {
   hipsens_time_t eond_start_delay;
   hipsens_time_t eostc_start_delay;
   int transmit_rate_limit;
+  /** when non-zero, opera_event_packet_received may request a transmit
+      buffer in the same cycle (for pending STC and Tree Status messages) */
+  int immediate_response;
+#ifdef WITH_OPERA_TX_SCHEDULER
+  opera_tx_class_config_t tx_class_config[OPERA_TX_CLASS_NB];
+#endif /* WITH_OPERA_TX_SCHEDULER */
 } opera_config_t;
 
+#ifdef WITH_OPERA_ARENA
+
+/** Sizes of the tables of one OPERA instance (see opera_set_arena) */
+typedef struct s_opera_capacity_t {
+  hipsens_u16 max_neighbor; /**< EOND and SERENA neighbors, EOSTC children */
+  hipsens_u8 max_stc_tree;  /**< must be > max_stc_serena_tree */
+  hipsens_u8 max_stc_serena_tree;
+} opera_capacity_t;
+
+#ifndef OPERA_ARENA_ALIGNMENT
+#define OPERA_ARENA_ALIGNMENT 8 /* must be a power of 2 */
+#endif
+
+#define OPERA_ARENA_ALIGN(size) \
+  (((size) + OPERA_ARENA_ALIGNMENT-1) & ~(OPERA_ARENA_ALIGNMENT-1))
+
+#ifdef WITH_OPERA_MULTI_CHANNEL
+#define OPERA_ARENA_CHANNEL_SIZE(max_neighbor) \
+  OPERA_ARENA_ALIGN((max_neighbor) * MAX_NODE_COLOR * sizeof(byte))
+#else
+#define OPERA_ARENA_CHANNEL_SIZE(max_neighbor) 0
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
+/** Size of the arena for the given capacities (usable for static arrays) */
+#define OPERA_ARENA_SIZE(max_neighbor, max_stc_tree, max_stc_serena_tree) \
+  ( OPERA_ARENA_ALIGN((max_neighbor) * sizeof(eond_neighbor_t))		\
+    + OPERA_ARENA_ALIGN((max_neighbor) * sizeof(serena_neighbor_t))	\
+    + OPERA_ARENA_ALIGN((max_neighbor) * MAX_NODE_COLOR * sizeof(byte))	\
+    + OPERA_ARENA_CHANNEL_SIZE(max_neighbor)				\
+    + OPERA_ARENA_ALIGN((max_stc_tree) * sizeof(eostc_tree_t))		\
+    + OPERA_ARENA_ALIGN((max_stc_serena_tree) * sizeof(eostc_serena_tree_t)) \
+    + (max_stc_serena_tree)						\
+       * OPERA_ARENA_ALIGN((max_neighbor) * sizeof(eostc_child_t)) )
+
+/* error codes (returned as negative values) */
+#define OPERA_ARENA_BAD_CAPACITY (-1)
+#define OPERA_ARENA_NO_MEMORY (-2)
+
+#endif /* WITH_OPERA_ARENA */
+
 /**
  * OPERA, the main interface for EOLSR strategic + SERENA, it includes
  * the state of sub-modules EOND, EOSTC, SERENA
@@ -171,12 +254,33 @@ typedef struct s_opera_state_t {
   hipsens_bool should_inc_colored_tree_seq :1; /**< triggers recoloring */
   hipsens_bool should_stop_stc_generation :1; /**< stop STC */
 
+  hipsens_bool is_stopped          :1; /**< see opera_stop */
+  hipsens_bool should_process_when_stopped :1; /**< see opera_stop */
+
     
 #ifdef WITH_OPERA_ADDRESS_FILTER
-#define MAX_FILTER_ADDRESS 3
-  byte filter_nb_address;
+  hipsens_u16 filter_nb_address;
   enum { FilterNone = 0, FilterReject = 1, FilterOnlyAccept = 2 } filter_mode;
-  address_t address_filter[MAX_FILTER_ADDRESS];
+  address_t address_filter[MAX_FILTER_ADDRESS]; /**< sorted (address_cmp) */
+#endif
+
+#ifdef WITH_OPERA_TX_SCHEDULER
+  opera_tx_bucket_t tx_bucket[OPERA_TX_CLASS_NB];
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  opera_central_state_t central_state;
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  /* the tree for which the SERENA topology was set */
+  address_t colored_root_address;
+  hipsens_u16 colored_tree_seq_num;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
+#ifdef WITH_OPERA_ARENA
+  void* arena; /**< memory of all the tables of the sub-modules */
+  hipsens_bool is_arena_owned :1; /**< allocated by opera (freed on close) */
 #endif
 
 } opera_state_t;
@@ -186,6 +290,45 @@ typedef struct s_opera_state_t {
  */
 void opera_config_init_default(opera_config_t* config);
 
+/* error codes of opera_config_apply (returned as negative values) */
+#define OPERA_CONFIG_BAD_INTERVAL  (-1) /**< zero, not above the jitter, or max < min,
+					    or a Color interval below
+					    SERENA_MIN_COLOR_INTERVAL */
+#define OPERA_CONFIG_BAD_HOLD_TIME (-2) /**< not above the interval */
+#define OPERA_CONFIG_BAD_POLICY    (-3) /**< unknown eviction policy or slot order */
+#define OPERA_CONFIG_BAD_NB_SLOT   (-4) /**< above MAX_NODE_COLOR */
+#define OPERA_CONFIG_BAD_NB_CHANNEL (-5) /**< zero */
+#define OPERA_CONFIG_BAD_CONFLICT_DISTANCE (-6) /**< not 2 or 3 */
+#define OPERA_CONFIG_BAD_BUCKET    (-7) /**< empty bucket with a refill */
+
+/**
+ * Changes the configuration of a running OPERA node to `new_config'
+ * (which is copied into the configuration given to opera_init):
+ * - the values are validated first ; if one is invalid, nothing is changed
+ *   and an OPERA_CONFIG_* error code is returned
+ * - the pending generation times of Hello, STC and Color messages are
+ *   rescheduled proportionally to the change of their interval
+ * - when only msg_color_interval is changed, the values derived from it
+ *   (Color interval bounds, central_timeout) follow it
+ * - when a hold time is changed, the corresponding message (Hello, or
+ *   STC on the root) is generated at once to advertise it
+ * Returns 0 on success.
+ */
+int opera_config_apply(opera_state_t* state, opera_config_t* new_config);
+
+#ifdef WITH_OPERA_ADDRESS_FILTER
+/**
+ * Address filter, applied on the sender of every received packet before
+ * any parsing (FilterReject: drop the packets of the listed addresses,
+ * FilterOnlyAccept: drop the packets of all the other addresses).
+ * - `opera_address_filter_reset' empties the list and sets the mode
+ * - `opera_address_filter_add' adds an address to the list (kept sorted,
+ *   the check is a binary search) ; returns 0, or -1 if the list is full
+ */
+void opera_address_filter_reset(opera_state_t* state, int filter_mode);
+int opera_address_filter_add(opera_state_t* state, address_t address);
+#endif /* WITH_OPERA_ADDRESS_FILTER */
+
 /**
  * Initialize an OPERA node.
  * - state is typically a variable defined in the caller and called every time
@@ -229,9 +372,27 @@ hipsens_bool opera_get_next_hop(opera_state_t* state,
  * - after this call, `opera_get_next_event_time' will return a useful time
  * - calling the function with an already started `state', is allowed
  *   and results in "restarting" (`opera_init' does not need to be called again)
+ * - calling the function after `opera_stop' resumes OPERA with the existing
+ *   tables (no restart)
  */
 void opera_start(opera_state_t* state);
 
+/**
+ * Stops OPERA temporarily (for instance during a maintenance of the CPAN):
+ * - no message is generated anymore (opera_event_new_cycle and
+ *   opera_event_wakeup_with_buffer return HIPSENS_FALSE)
+ * - received packets are processed iff `should_process_packet' is true,
+ *   otherwise they are ignored
+ * - the clock of OPERA is not advanced by the cycles while stopped, hence
+ *   on `opera_start', all the timers (neighbor/tree expiration,
+ *   message generation, ...) are shifted by the stopped interval and
+ *   OPERA continues with the existing tables, as if it had not been
+ *   stopped (neighbors, trees and colors do not expire).
+ * To restart with empty tables instead, `opera_init' should be called
+ * before `opera_start'.
+ */
+void opera_stop(opera_state_t* state, hipsens_bool should_process_packet);
+
 /* XXX: to document */
 void opera_close(opera_state_t* state);
 
@@ -271,6 +432,27 @@ void opera_start_eostc(opera_state_t* state, hipsens_bool with_serena);
 hipsens_bool opera_event_new_cycle(opera_state_t* state,
 		   byte unused_What_Is_Current_Tn /*XXX: decide if useful*/);
 
+/**
+ * Tickless variant of `opera_event_new_cycle': instead of calling OPERA
+ * at every cycle, the caller may skip the cycles in which OPERA has
+ * nothing to do:
+ * - `opera_get_cycles_until_wakeup' returns the number N of cycles after
+ *   the current one, at which OPERA must be called again (at the latest),
+ *   or OPERA_NO_WAKEUP if only external events (received packets, serial
+ *   commands) can give some work to OPERA.
+ * - `opera_event_new_cycles' must then be called with the number of
+ *   cycles elapsed since the previous call (N, or fewer) ; it has the 
+ *   same return value as `opera_event_new_cycle'.
+ * The number N must be recomputed after every call to an opera_event_*
+ * function and after every serial command. When a packet is received in
+ * a cycle where OPERA was not called, `opera_event_new_cycles' must be
+ * called first (for the clock to be updated).
+ */
+#define OPERA_NO_WAKEUP 0
+hipsens_time_t opera_get_cycles_until_wakeup(opera_state_t* state);
+hipsens_bool opera_event_new_cycles(opera_state_t* state,
+				    hipsens_time_t nb_cycle);
+
 
 typedef struct s_opera_packet_t {
   /* filled by caller */
@@ -314,11 +496,30 @@ hipsens_bool opera_event_wakeup_with_buffer
  * (it may be freed)
  * - for OCARI, the `rssi' implementation needs to be defined
  * - the return value indicates if OPERA wishes to send a packet immediatly
- *   (typically as a result of the packet just received).
+ *   (typically as a result of the packet just received). It is always
+ *   HIPSENS_FALSE unless `opera_config_t.immediate_response' is set; if it
+ *   is HIPSENS_TRUE, the caller should call `opera_event_wakeup_with_buffer'
+ *   within the current cycle (`transmit_rate_limit' is respected).
  */
 hipsens_bool opera_event_packet_received
 (opera_state_t* state, byte* packet_data, int packet_size, hipsens_u8 rssi);
 
+typedef struct s_received_packet_t {
+  byte* packet_data;
+  int packet_size;
+  hipsens_u8 rssi;
+} received_packet_t;
+
+/**
+ * Same as calling `opera_event_packet_received' for each of the
+ * `nb_packet' packets of `packet_list' (in order), but the neighbor
+ * changes, the SERENA start check and the wakeup condition are processed
+ * once for the whole batch.
+ * Intended for callers receiving several frames per cycle.
+ */
+hipsens_bool opera_event_packets_received
+(opera_state_t* state, received_packet_t* packet_list, int nb_packet);
+
 /*---------------------------------------------------------------------------
  * Coloring API
  *---------------------------------------------------------------------------*/
@@ -435,6 +636,32 @@ void opera_direct_start(opera_state_t* state, hipsens_time_t current_time);
 void opera_direct_init(opera_state_t* state, opera_config_t* config,
 		       hipsens_time_t current_time, void* opaque_extra_info); //added-ridha (for file hipsens-opera)
 
+#ifdef WITH_OPERA_ARENA
+/** Returns the size of the arena required for `capacity' */
+int opera_arena_size(opera_capacity_t* capacity);
+
+/**
+ * Carves all the tables of EOND, EOSTC and SERENA from `arena' (of
+ * size at least opera_arena_size(capacity)). Must be called once,
+ * before `opera_init'/`opera_direct_init' (the tables are kept by later
+ * re-initializations). The arena remains owned by the caller.
+ * Returns 0, or OPERA_ARENA_BAD_CAPACITY.
+ */
+int opera_set_arena(opera_state_t* state, opera_capacity_t* capacity,
+		    void* arena);
+
+/**
+ * Same as opera_set_arena followed by opera_direct_init ; when `arena'
+ * is NULL, it is allocated (host only) and freed by `opera_close'.
+ * Returns 0, or OPERA_ARENA_BAD_CAPACITY/OPERA_ARENA_NO_MEMORY.
+ */
+int opera_direct_init_with_capacity(opera_state_t* state,
+				    opera_config_t* config,
+				    opera_capacity_t* capacity, void* arena,
+				    hipsens_time_t current_time,
+				    void* opaque_extra_info);
+#endif /* WITH_OPERA_ARENA */
+
 
 #ifdef WITH_SIMUL
 //void opera_update_config(opera_config_t* config);
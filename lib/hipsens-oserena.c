@@ -77,8 +77,48 @@ void serena_config_init_default(serena_config_t* config)
   /* note: fixed_priority is not used when Priority_mode_tree (set anyway): */
   config->recoloring_delay = 0; /* 0 = do not recolor */
   SET_PRIORITY(config->fixed_priority,1); 
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  config->central_coloring = HIPSENS_TRUE;
+  config->central_timeout = SERENA_CENTRAL_TIMEOUT(config->msg_color_interval);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  config->repair_duration = 16 * config->msg_color_interval;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+#ifdef WITH_OPERA_SLOT_ORDER
+  config->slot_order = Slot_order_children_first;
+#endif /* WITH_OPERA_SLOT_ORDER */
+#ifdef WITH_OPERA_MULTI_SLOT
+  config->nb_slot = 0;
+  config->nb_descendant_per_slot = 8;
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  config->nb_channel = 2;
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  config->conflict_distance = 3;
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  config->max_suppressed_color = 4;
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  serena_config_set_color_interval_bounds(config);
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
 }
 
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+/* derives min_color_interval and max_color_interval from
+   msg_color_interval */
+void serena_config_set_color_interval_bounds(serena_config_t* config)
+{
+  /* never faster than the fixed interval: no more Color messages (and
+     no more traffic) than without WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+  config->min_color_interval = config->msg_color_interval;
+  if (config->min_color_interval < SERENA_MIN_COLOR_INTERVAL)
+    config->min_color_interval = SERENA_MIN_COLOR_INTERVAL;
+  config->max_color_interval = 4 * config->msg_color_interval;
+}
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+
 
 /* minimum initialisation for serena */
 void new__serena_state_init(serena_state_t* state, base_state_t* base,
@@ -91,7 +131,25 @@ void new__serena_state_init(serena_state_t* state, base_state_t* base,
   state->is_topology_set = HIPSENS_FALSE;
   state->is_finished = HIPSENS_FALSE;
   state->next_msg_color_time = undefined_time;
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  state->is_update_requested = HIPSENS_TRUE;
+  state->nb_suppressed_color = 0;
+  state->last_color_hash = 0;
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  state->color_interval = config->msg_color_interval;
+  state->last_content_hash = 0;
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
   state->callback_coloring_finished = NULL;
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  state->callback_max_color_increase = NULL;
+  state->is_repairing = HIPSENS_FALSE;
+  state->repair_end_time = undefined_time;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  state->central_color = COLOR_NONE;
+  state->central_deadline = undefined_time;
+#endif /* WITH_OPERA_CENTRAL_COLORING */
 #if defined(WITHOUT_LOSS) && defined(WITH_SIMUL)
   state->is_stopped = HIPSENS_FALSE;
   state->nb_sent_msg = 0;
@@ -99,6 +157,17 @@ void new__serena_state_init(serena_state_t* state, base_state_t* base,
   state->first_empty_msg = HIPSENS_FALSE;
 #endif //defined(WITHOUT_LOSS) && defined(WITH_SIMUL)
   state->color_seq_num = 0;
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  state->has_used_color = HIPSENS_FALSE;
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+  state->tree_nb_color = 0;
+#endif /* WITH_OPERA_SLOT_ORDER */
+#ifdef WITH_OPERA_MULTI_SLOT
+  bitmap_init(&(state->node_color_bitmap));
+  state->nb_descendant = 1;
+  state->final_nb_node_color = 0;
+#endif /* WITH_OPERA_MULTI_SLOT */
 }
 
 /* this is NO_COLOR in OCARI */
@@ -118,6 +187,9 @@ void new__serena_start(serena_state_t* state)
     return;
   state->is_started = HIPSENS_TRUE;
   state->is_finished = HIPSENS_FALSE;
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  state->is_repairing = HIPSENS_FALSE;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
 
   int i;
   for (i=0; i<state->nb_neighbor; i++) {
@@ -130,6 +202,18 @@ void new__serena_start(serena_state_t* state)
     
     current_neigh->has_sent_max_color = HIPSENS_FALSE;
     current_neigh->child_max_color = COLOR_NONE;
+#ifdef WITH_OPERA_COLOR_COMPACTION
+    bitmap_init(&(current_neigh->child_color_bitmap));
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+    current_neigh->child_latency = 0;
+#endif /* WITH_OPERA_SLOT_ORDER */
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+    current_neigh->is_subtree_informed = HIPSENS_FALSE;
+#endif
+#ifdef WITH_OPERA_MULTI_SLOT
+    bitmap_init(&(current_neigh->node_color_bitmap));
+#endif /* WITH_OPERA_MULTI_SLOT */
 
     /* clean previous max prio */
     int j;
@@ -141,7 +225,14 @@ void new__serena_start(serena_state_t* state)
   }
 
   state->color = COLOR_NONE;
+#ifdef WITH_OPERA_MULTI_SLOT
+  bitmap_init(&(state->node_color_bitmap));
+#endif /* WITH_OPERA_MULTI_SLOT */
   // XXX: not set: state->priority = PRIORITY_NONE;   
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  state->central_deadline = HIPSENS_TIME_ADD(state->base->current_time,
+					     state->config->central_timeout);
+#endif /* WITH_OPERA_CENTRAL_COLORING */
 #if defined(DBG_SERENA)
   state->coloring_time = undefined_time;
 #endif
@@ -153,6 +244,13 @@ void new__serena_start(serena_state_t* state)
 #endif /* IMPLICIT_COLORING_DETECTION */
 
   state->last_nb_color = 0;
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  state->has_used_color = HIPSENS_FALSE;
+  bitmap_init(&(state->used_color_bitmap));
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+  state->tree_nb_color = 0;
+#endif /* WITH_OPERA_SLOT_ORDER */
 
   bitmap_init(&(state->color_bitmap1));
   bitmap_init(&(state->color_bitmap2));
@@ -161,11 +259,24 @@ void new__serena_start(serena_state_t* state)
   state->next_msg_color_time = base_state_time_after_delay_jitter
     (state->base, state->config->msg_color_interval,
      state->config->max_jitter_time);
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  state->is_update_requested = HIPSENS_TRUE; /* the first one is sent */
+  state->nb_suppressed_color = 0;
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  state->color_interval = state->config->msg_color_interval;
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
   state->is_started = HIPSENS_TRUE;
+  STTRACE(OPERA_TRACE_SERENA_START, state->tree_seq_num, state->nb_neighbor,
+	  GET_PRIORITY(state->priority));
+  STMETRIC_INC(OPERA_METRIC_COLORING_START);
 
   /* external information */
   state->final_nb_neighbor_color = 0;
   state->final_node_color = OCARI_NO_COLOR;
+#ifdef WITH_OPERA_MULTI_SLOT
+  state->final_nb_node_color = 0;
+#endif /* WITH_OPERA_MULTI_SLOT */
 }
 
 int serena_find_neighbor_index(serena_state_t* state, address_t address)
@@ -179,13 +290,31 @@ int serena_find_neighbor_index(serena_state_t* state, address_t address)
   return -1;
 }
 
+int serena_find_neighbor_index_by_id(serena_state_t* state,
+				     neighbor_id_t neighbor_id)
+{
+  int low = 0, high = state->nb_neighbor - 1;
+  while (low <= high) {
+    int middle = (low + high) / 2;
+    neighbor_id_t middle_id = state->neighbor_table[middle].neighbor_id;
+    if (middle_id == neighbor_id)
+      return middle;
+    else if (middle_id < neighbor_id)
+      low = middle + 1;
+    else high = middle - 1;
+  }
+  return -1;
+}
+
+/* note: the order of the other neighbors is kept (sorted by neighbor_id) */
 void serena_remove_neighbor(serena_state_t* state, int neighbor_index)
 {
   ASSERT( neighbor_index < state->nb_neighbor );
   if (neighbor_index < state->nb_neighbor-1) {
-    memcpy( &state->neighbor_table[neighbor_index], 
-	    &state->neighbor_table[state->nb_neighbor-1],
-	    sizeof(serena_neighbor_t) );
+    memmove( &state->neighbor_table[neighbor_index], 
+	     &state->neighbor_table[neighbor_index+1],
+	     (state->nb_neighbor-1-neighbor_index) 
+	     * sizeof(serena_neighbor_t) );
   }
   state->nb_neighbor --;
 }
@@ -386,6 +515,29 @@ static int bitmap_get_size(bitmap_t* bitmap)
   return result;
 }
 
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_MULTI_SLOT) \
+  || defined(WITH_OPERA_MULTI_CHANNEL) || defined(WITH_OPERA_COLOR_SUPPRESSION)
+static hipsens_bool bitmap_has_bit(bitmap_t* bitmap, int pos)
+{
+  if (pos < 0 || BYTE_OF_BIT(pos) >= BYTES_PER_BITMAP)
+    return HIPSENS_FALSE;
+  return (bitmap->content[BYTE_OF_BIT(pos)]
+	  & MASK_OF_INDEX(INDEX_OF_BIT(pos))) != 0;
+}
+#endif
+
+#ifdef WITH_OPERA_COLOR_COMPACTION
+/* number of bits set at positions lower than `pos' */
+static int bitmap_count_bit_lower_than(bitmap_t* bitmap, int pos)
+{
+  int i, result = 0;
+  for (i=0; i<pos && BYTE_OF_BIT(i)<BYTES_PER_BITMAP; i++)
+    if (bitmap_has_bit(bitmap, i))
+      result++;
+  return result;
+}
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+
 static void buffer_get_bitmap(serena_state_t* state, 
 			      buffer_t* buffer, bitmap_t* bitmap)
 {
@@ -431,6 +583,9 @@ static hipsens_bool serena_has_color(serena_state_t* state, address_t* address)
   hipsens_bool has_color = (serena_get_color(state, address) != COLOR_NONE);
   if (has_color)
     return HIPSENS_TRUE;
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  if (hipsens_address_equal(*address, my_address))
+    return state->color != COLOR_NONE;
 
 #ifdef IMPLICIT_COLORING_DETECTION
   int i;
@@ -502,6 +657,28 @@ static void notify_update_neighbor_prio(serena_state_t* state,
 }
 
 #define SHORT_HEADER_SIZE 2
+
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+/* the tables were changed by a Color message: the next Color message is
+   sent after at most `min_color_interval' */
+static void serena_notify_table_change(serena_state_t* state)
+{
+  serena_config_t* config = state->config;
+  state->color_interval = config->min_color_interval;
+  if (state->is_finished || state->next_msg_color_time == undefined_time)
+    return;
+  hipsens_time_t next_time = base_state_time_after_delay_jitter
+    (state->base, config->min_color_interval, config->max_jitter_time);
+  if (HIPSENS_TIME_COMPARE_NO_UNDEF(next_time, <,
+				    state->next_msg_color_time))
+    state->next_msg_color_time = next_time;
+}
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+static hipsens_bool serena_has_tree_info(serena_state_t* state);
+#endif
+
 static void serena_internal_process_message(serena_state_t* state,
 					    buffer_t* buffer)
 {
@@ -512,6 +689,7 @@ static void serena_internal_process_message(serena_state_t* state,
 
   if (buffer_get_byte(buffer) != HIPSENS_MSG_COLOR) {
     STWARN("bad message header, expected HIPSENS_MSG_COLOR");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
     return;
   }
   int message_size = buffer_get_u8(buffer);
@@ -525,6 +703,24 @@ static void serena_internal_process_message(serena_state_t* state,
   buffer_get_ADDRESS(buffer, root_address);
   hipsens_u16 tree_seq_num = buffer_get_u16(buffer);
   hipsens_u8 nb_color = buffer_get_u8(buffer);
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  hipsens_u8 conflict_distance = buffer_get_u8(buffer);
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+  if (buffer->status != HIPSENS_TRUE) {
+    STWARN("parse error in color message header\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  if (conflict_distance != SERENA_CONFLICT_DISTANCE(state->config)) {
+    /* the rest of the message (Max2Prio2, Bitmap2) has another format */
+    STWARN("color message with conflict distance %d ignored (ours: %d)\n",
+	   conflict_distance, SERENA_CONFLICT_DISTANCE(state->config));
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+  STMETRIC_INC(OPERA_METRIC_COLOR_PARSED);
 
   STWRITE(DBGnd || DBGmsgdat, address_write, originator);
   //STLOG(DBGsrn || DBGmsgdat, " [");
@@ -533,15 +729,16 @@ static void serena_internal_process_message(serena_state_t* state,
   STLOG(DBGsrn || DBGmsg || DBGmsgdat, "\n");
 
   if (!state->is_started) {
-#ifndef WITH_START_ON_COLOR_MESSAGE
+#if !defined(WITH_START_ON_COLOR_MESSAGE) && !defined(WITH_OPERA_LOCAL_RECOLORING)
     return;
 #endif    
     
     if (!state->is_topology_set) {
       /* Note: we don't know the topology, will be handled by EOSTC */
+#ifndef WITH_OPERA_LOCAL_RECOLORING
       STWARN("Color message received, but node is not started, "
 	     "and has no topology.\n");
-      
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
       return;
     }
   }
@@ -588,12 +785,33 @@ static void serena_internal_process_message(serena_state_t* state,
     return;
   }
   serena_neighbor_t* neighbor = &(state->neighbor_table[neigh_index]);
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  /* to detect the changes of the tables */
+  serena_neighbor_t previous_neighbor;
+  bitmap_t previous_color_bitmap[3];
+  memcpy(&previous_neighbor, neighbor, sizeof(serena_neighbor_t));
+  memcpy(&previous_color_bitmap[0], &(state->color_bitmap1), sizeof(bitmap_t));
+  memcpy(&previous_color_bitmap[1], &(state->color_bitmap2), sizeof(bitmap_t));
+  memcpy(&previous_color_bitmap[2], &(state->color_bitmap3), sizeof(bitmap_t));
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  /* to detect the local changes */
+  bitmap_t previous_color_bitmap1;
+  bitmap_t previous_color_bitmap2;
+  byte previous_child_max_color = neighbor->has_sent_max_color ?
+    neighbor->child_max_color : COLOR_NONE;
+  memcpy(&previous_color_bitmap1, &(state->color_bitmap1), sizeof(bitmap_t));
+  memcpy(&previous_color_bitmap2, &(state->color_bitmap2), sizeof(bitmap_t));
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
   
   byte neigh_color = buffer_get_byte(buffer);
   //byte neigh_priority = buffer_get_byte(buffer);
   priority_t neigh_priority;
   buffer_get_PRIORITY(buffer, neigh_priority);
 
+  STTRACE(OPERA_TRACE_SERENA_COLOR_RECEIVED, TRACE_ADDRESS(originator),
+	  neigh_color, nb_color);
+
   /*--- Update whenever a neighbor has already a color ---*/
   neighbor->color = neigh_color;
   hipsens_bool has_color = (neigh_color != COLOR_NONE);
@@ -601,6 +819,9 @@ static void serena_internal_process_message(serena_state_t* state,
     bitmap_set_bit(&(state->color_bitmap1), neigh_color,  state);
 
   /*--- Update all the priority information ---*/
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  hipsens_bool is_new_neighbor = !neighbor->has_prio;
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
   neighbor->has_prio = HIPSENS_TRUE;
   neighbor->priority = neigh_priority; /* address is already there */
 
@@ -630,25 +851,27 @@ static void serena_internal_process_message(serena_state_t* state,
   
   notify_update_neighbor_prio(state, MAX_PRIO1_SIZE, previous_max2_prio1, neighbor->max2_prio1);
 
-  /* update neighbor->max2_prio2 for Max2Prio3 */
-  byte nb_max2_prio2 = buffer_get_byte(buffer);
-  neighbor->has_prio2 |= (nb_max2_prio2 > 0) || has_color; /* XXX: hack */
+  if (SERENA_CONFLICT_DISTANCE(state->config) >= 3) {
+    /* update neighbor->max2_prio2 for Max2Prio3 */
+    byte nb_max2_prio2 = buffer_get_byte(buffer);
+    neighbor->has_prio2 |= (nb_max2_prio2 > 0) || has_color; /* XXX: hack */
  
-  addr_priority_t previous_max2_prio2[MAX_PRIO2_SIZE];
-  memcpy(&previous_max2_prio2, neighbor->max2_prio2, sizeof(previous_max2_prio2));
-  for (i=0; i<nb_max2_prio2; i++) {
-    addr_priority_t neigh_max2_prio2;
-    buffer_get_PRIORITY(buffer, neigh_max2_prio2.priority);
-    buffer_get_data(buffer, neigh_max2_prio2.address, ADDRESS_SIZE);
-    //update_neighbor_prio(state, &(neighbor->max2_prio1[i]), &neigh_max2_prio1);
-    memcpy( &(neighbor->max2_prio2[i]), & neigh_max2_prio2, 
-        sizeof(addr_priority_t));
-  }
+    addr_priority_t previous_max2_prio2[MAX_PRIO2_SIZE];
+    memcpy(&previous_max2_prio2, neighbor->max2_prio2, sizeof(previous_max2_prio2));
+    for (i=0; i<nb_max2_prio2; i++) {
+      addr_priority_t neigh_max2_prio2;
+      buffer_get_PRIORITY(buffer, neigh_max2_prio2.priority);
+      buffer_get_data(buffer, neigh_max2_prio2.address, ADDRESS_SIZE);
+      //update_neighbor_prio(state, &(neighbor->max2_prio1[i]), &neigh_max2_prio1);
+      memcpy( &(neighbor->max2_prio2[i]), & neigh_max2_prio2, 
+	  sizeof(addr_priority_t));
+    }
   
-  for (i=nb_max2_prio2;  i<MAX_PRIO2_SIZE; i++)
-    addr_priority_init(&(neighbor->max2_prio2[i]));
+    for (i=nb_max2_prio2;  i<MAX_PRIO2_SIZE; i++)
+      addr_priority_init(&(neighbor->max2_prio2[i]));
   
-  notify_update_neighbor_prio(state, MAX_PRIO2_SIZE, previous_max2_prio2, neighbor->max2_prio2);
+    notify_update_neighbor_prio(state, MAX_PRIO2_SIZE, previous_max2_prio2, neighbor->max2_prio2);
+  } /* otherwise: no Max2Prio2 in the message */
 
   /*--- Update all the color information ---*/
 
@@ -661,22 +884,217 @@ static void serena_internal_process_message(serena_state_t* state,
   if (state->color != COLOR_NONE)
     bitmap_clear_bit(&(state->color_bitmap2), state->color,  state);
 
-  bitmap_t neigh_color_bitmap2;
-  buffer_get_bitmap(state, buffer, &neigh_color_bitmap2);
-  bitmap_union(&(state->color_bitmap3), /*=*/
-	       &(state->color_bitmap3), /*|*/ &neigh_color_bitmap2);  
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  /* the neighbor misses our information (first message heard from it,
+     our priority or our color not yet known): do not skip the next
+     Color message */
+  if (is_new_neighbor
+      || (state->color == COLOR_NONE && nb_max2_prio1 == 0)
+      || (state->color != COLOR_NONE
+	  && !bitmap_has_bit(&neigh_color_bitmap1, state->color)))
+    state->is_update_requested = HIPSENS_TRUE;
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+
+  if (SERENA_CONFLICT_DISTANCE(state->config) >= 3) {
+    bitmap_t neigh_color_bitmap2;
+    buffer_get_bitmap(state, buffer, &neigh_color_bitmap2);
+    bitmap_union(&(state->color_bitmap3), /*=*/
+		 &(state->color_bitmap3), /*|*/ &neigh_color_bitmap2);  
+  } /* otherwise: no Bitmap2 in the message */
+
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER) \
+  || defined(WITH_OPERA_MULTI_SLOT)
+  (void) buffer_get_u16(buffer); /* color seq num */
+#endif
+
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  bitmap_t subtree_color_bitmap;
+  bitmap_t used_color_bitmap;
+  buffer_get_bitmap(state, buffer, &subtree_color_bitmap);
+  buffer_get_bitmap(state, buffer, &used_color_bitmap);
+  if (buffer->status != HIPSENS_TRUE) {
+    STWARN("parse error in color message (used colors)\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+  if (neighbor->is_parent && !state->has_used_color
+      && bitmap_get_size(&used_color_bitmap) > 0)
+    serena_set_used_color(state, &used_color_bitmap);
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+  byte neigh_tree_nb_color = buffer_get_u8(buffer);
+  byte neigh_latency = buffer_get_u8(buffer);
+  if (buffer->status != HIPSENS_TRUE) {
+    STWARN("parse error in color message (slot order)\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+  if (neighbor->is_parent && state->tree_nb_color == 0
+      && neigh_tree_nb_color > 0)
+    serena_set_tree_nb_color(state, neigh_tree_nb_color);
+#endif /* WITH_OPERA_SLOT_ORDER */
+
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+  byte neigh_is_subtree_informed = buffer_get_u8(buffer);
+  if (buffer->status != HIPSENS_TRUE) {
+    STWARN("parse error in color message (tree information)\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+  neighbor->is_subtree_informed = (neigh_is_subtree_informed != 0);
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  if (neighbor->is_child && serena_has_tree_info(state)
+      && !neighbor->is_subtree_informed)
+    state->is_update_requested = HIPSENS_TRUE; /* the child misses it */
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+#endif
+
+#ifdef WITH_OPERA_MULTI_SLOT
+  /* the other colors of the neighbor are 1-hop colors as its color */
+  buffer_get_bitmap(state, buffer, &(neighbor->node_color_bitmap));
+  if (buffer->status != HIPSENS_TRUE) {
+    STWARN("parse error in color message (node colors)\n");
+    STMETRIC_INC(OPERA_METRIC_PARSE_ERROR);
+    return;
+  }
+  if (has_color) {
+    bitmap_set_bit(&(neighbor->node_color_bitmap), neigh_color, state);
+    bitmap_union(&(state->color_bitmap1), /*=*/
+		 &(state->color_bitmap1), /*|*/ &(neighbor->node_color_bitmap));
+  } else bitmap_init(&(neighbor->node_color_bitmap));
+  bitmap_difference(&(state->color_bitmap2), /*=*/ &(state->color_bitmap2),
+		    /*-*/ &(state->color_bitmap1));
+  bitmap_difference(&(state->color_bitmap2), /*=*/ &(state->color_bitmap2),
+		    /*-*/ &(state->node_color_bitmap));
+#endif /* WITH_OPERA_MULTI_SLOT */
 
   /* update MAX_COLOR information */
   if (nb_color > 0) {
     neighbor->has_sent_max_color = HIPSENS_TRUE; /* XXX:reset in case of tree change */
     neighbor->child_max_color = nb_color - 1;
+#ifdef WITH_OPERA_COLOR_COMPACTION
+    memcpy(&(neighbor->child_color_bitmap), &subtree_color_bitmap,
+	   sizeof(bitmap_t));
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+    neighbor->child_latency = neigh_latency;
+#endif /* WITH_OPERA_SLOT_ORDER */
   }
 
   /* XXX: can parse the color seq num here */
 
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  if ((state->is_finished || state->is_repairing) && serena_is_colored(state)) {
+    /* a colored node repeats the changes in its 3-hop neighborhood */
+    bitmap_t new_color_bitmap;
+    bitmap_difference(&new_color_bitmap, &(state->color_bitmap1),
+		      &previous_color_bitmap1);
+    hipsens_bool has_change = (bitmap_get_size(&new_color_bitmap) > 0);
+    bitmap_difference(&new_color_bitmap, &(state->color_bitmap2),
+		      &previous_color_bitmap2);
+    has_change |= (bitmap_get_size(&new_color_bitmap) > 0);
+    has_change |= (neigh_color == COLOR_NONE); /* a neighbor is coloring */
+    has_change |= (neighbor->is_child && nb_color > 0
+		   && (previous_child_max_color == COLOR_NONE
+		       || nb_color-1 > previous_child_max_color));
+    if (has_change)
+      serena_start_repair(state);
+  }
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  if (memcmp(&previous_neighbor, neighbor, sizeof(serena_neighbor_t)) != 0
+      || memcmp(&previous_color_bitmap[0], &(state->color_bitmap1),
+		sizeof(bitmap_t)) != 0
+      || memcmp(&previous_color_bitmap[1], &(state->color_bitmap2),
+		sizeof(bitmap_t)) != 0
+      || memcmp(&previous_color_bitmap[2], &(state->color_bitmap3),
+		sizeof(bitmap_t)) != 0)
+    serena_notify_table_change(state);
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+
   STLOG(DBGsrn, "\n");
 }
 
+#ifdef WITH_OPERA_MULTI_SLOT
+/* number of colors that the node should take */
+static int serena_get_nb_slot(serena_state_t* state)
+{
+  int nb_slot = state->config->nb_slot;
+  int nb_descendant_per_slot = state->config->nb_descendant_per_slot;
+  if (nb_slot == 0 && nb_descendant_per_slot > 0)
+    nb_slot = (state->nb_descendant + nb_descendant_per_slot - 1)
+      / nb_descendant_per_slot;
+  if (nb_slot < 1)
+    nb_slot = 1;
+  if (nb_slot > MAX_NODE_COLOR)
+    nb_slot = MAX_NODE_COLOR;
+  return nb_slot;
+}
+
+/* once `state->color' is chosen, the other colors of the node are the
+   lowest colors above it which are not in `all_color_bitmap' */
+static void serena_set_node_color(serena_state_t* state,
+				  bitmap_t* all_color_bitmap)
+{
+  bitmap_t used_color_bitmap;
+  memcpy(&used_color_bitmap, all_color_bitmap, sizeof(bitmap_t));
+  bitmap_init(&(state->node_color_bitmap));
+  if (state->color == COLOR_NONE)
+    return;
+  bitmap_set_bit(&(state->node_color_bitmap), state->color, state);
+  bitmap_set_bit(&used_color_bitmap, state->color, state);
+
+  int nb_slot = serena_get_nb_slot(state);
+  int i;
+  for (i=1; i<nb_slot; i++) {
+    int color = bitmap_get_first_empty_bit_greater_than(&used_color_bitmap,
+							state->color);
+    if (color < 0 || color >= NB_COLOR_MAX) {
+      STWARN("no free color for slot %d of the node.\n", i);
+      break;
+    }
+    bitmap_set_bit(&(state->node_color_bitmap), color, state);
+    bitmap_set_bit(&used_color_bitmap, color, state);
+  }
+}
+
+/* the greatest color of the node */
+static int serena_get_max_node_color(serena_state_t* state)
+{
+  int color;
+  for (color=NB_COLOR_MAX-1; color>state->color; color--)
+    if (bitmap_has_bit(&(state->node_color_bitmap), color))
+      return color;
+  return state->color;
+}
+#endif /* WITH_OPERA_MULTI_SLOT */
+
+#ifdef WITH_OPERA_MULTI_CHANNEL
+int serena_get_nb_channel_slot(serena_state_t* state, int nb_color)
+{
+  int nb_channel = state->config->nb_channel;
+  return (nb_color + nb_channel - 1) / nb_channel;
+}
+
+/* adds to `result' all the colors of the slots of the colors in
+   `color_bitmap' */
+static void serena_block_slot(serena_state_t* state, bitmap_t* result,
+			      bitmap_t* color_bitmap)
+{
+  int nb_channel = state->config->nb_channel;
+  int color;
+  for (color=0; color<NB_COLOR_MAX; color++)
+    if (bitmap_has_bit(color_bitmap, color)) {
+      int first_color = color - (color % nb_channel);
+      int i;
+      for (i=0; i<nb_channel && first_color+i<NB_COLOR_MAX; i++)
+	bitmap_set_bit(result, first_color+i, state);
+    }
+}
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
 static int serena_update_color(serena_state_t* state,
 			       addr_priority_t* max_addr_priority)
 {
@@ -684,16 +1102,46 @@ static int serena_update_color(serena_state_t* state,
   if (state->color != COLOR_NONE)
     return HIPSENS_FALSE;
 
-  if (!serena_has_all_neigh_prio2(state)) 
-    return HIPSENS_FALSE;
+  bitmap_t all_color_bitmap;
+  bitmap_union(&all_color_bitmap, &(state->color_bitmap1),
+	       &(state->color_bitmap2));
+  bitmap_union(&all_color_bitmap, &all_color_bitmap, &(state->color_bitmap3));
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  /* only the nodes at 3 hops can share a slot (on different channels):
+     the whole slots of the 1-hop and 2-hop colors are used */
+  serena_block_slot(state, &all_color_bitmap, &(state->color_bitmap1));
+  if (SERENA_CONFLICT_DISTANCE(state->config) >= 3)
+    serena_block_slot(state, &all_color_bitmap, &(state->color_bitmap2));
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
+  if (SERENA_CONFLICT_DISTANCE(state->config) >= 3) {
+    if (!serena_has_all_neigh_prio2(state)) 
+      return HIPSENS_FALSE;
+  } else if (!serena_has_all_neigh_prio1(state))
+    return HIPSENS_FALSE; /* no Max2Prio2: the 2-hop priorities suffice */
   
   if (!IS_PRIORITY_NONE(max_addr_priority->priority)
       && hipsens_address_equal(max_addr_priority->address, my_address)) {
-    bitmap_t all_color_bitmap;
-    bitmap_union(&all_color_bitmap, &(state->color_bitmap1),
-		 &(state->color_bitmap2));
-    bitmap_union(&all_color_bitmap, &all_color_bitmap, &(state->color_bitmap3));
-    
+#ifdef WITH_OPERA_CENTRAL_COLORING
+    /* the assigned color is also taken in the order of the priorities:
+       a node which has fallen back on the distributed coloring never
+       chooses its color at the same time as a node of its neighborhood */
+    if (state->config->central_coloring) {
+      byte color = state->central_color;
+      if (color != COLOR_NONE
+	  && (all_color_bitmap.content[BYTE_OF_BIT(color)]
+	      & MASK_OF_INDEX(INDEX_OF_BIT(color))) == 0) {
+	state->color = color;
+	return HIPSENS_TRUE;
+      }
+      if (color != COLOR_NONE)
+	STWARN("assigned color already used, distributed coloring.\n");
+      else if (HIPSENS_TIME_COMPARE_LARGE_UNDEF
+	       (state->base->current_time, <, state->central_deadline))
+	return HIPSENS_FALSE; /* waiting for the assignment of the root */
+      /* otherwise: fall back on the distributed coloring */
+    }
+#endif /* WITH_OPERA_CENTRAL_COLORING */
     int min_color = 0;
 
     /* if there is a parent and it has a color, min_color is set to this */
@@ -708,6 +1156,9 @@ static int serena_update_color(serena_state_t* state,
     int indexBit = bitmap_get_first_empty_bit_greater_than(&all_color_bitmap,
 							   min_color);
     state->color = indexBit;
+#ifdef WITH_OPERA_MULTI_SLOT
+    serena_set_node_color(state, &all_color_bitmap);
+#endif /* WITH_OPERA_MULTI_SLOT */
     return HIPSENS_TRUE;
   } else return HIPSENS_FALSE;
 }
@@ -881,7 +1332,11 @@ int serena_get_nb_color(serena_state_t* state)
   int nb_color = 0;
 
   if (state->color != COLOR_NONE) {
+#ifdef WITH_OPERA_MULTI_SLOT
+    nb_color = serena_get_max_node_color(state) + 1;
+#else
     nb_color = state->color + 1;
+#endif /* WITH_OPERA_MULTI_SLOT */
     int i;
     for (i=0; i<state->nb_neighbor; i++) {
       if (state->neighbor_table[i].is_child) {
@@ -907,6 +1362,147 @@ int serena_get_nb_color(serena_state_t* state)
   return nb_color;
 }
 
+#ifdef WITH_OPERA_COLOR_COMPACTION
+hipsens_bool serena_get_subtree_color(serena_state_t* state, bitmap_t* result)
+{
+  bitmap_init(result);
+  if (state->color == COLOR_NONE)
+    return HIPSENS_FALSE;
+  bitmap_set_bit(result, state->color, state);
+#ifdef WITH_OPERA_MULTI_SLOT
+  bitmap_union(result, result, &(state->node_color_bitmap));
+#endif /* WITH_OPERA_MULTI_SLOT */
+  int i;
+  for (i=0; i<state->nb_neighbor; i++) {
+    serena_neighbor_t* neighbor = &state->neighbor_table[i];
+    if (!neighbor->is_child)
+      continue;
+    if (!neighbor->has_sent_max_color)
+      return HIPSENS_FALSE;
+    bitmap_union(result, result, &(neighbor->child_color_bitmap));
+  }
+  return HIPSENS_TRUE;
+}
+
+/* the color `color' after removal of the unused colors */
+static int serena_get_compact_color(serena_state_t* state, int color)
+{
+  if (!state->has_used_color)
+    return color;
+  return bitmap_count_bit_lower_than(&(state->used_color_bitmap), color);
+}
+
+static void serena_set_final_color(serena_state_t* state);
+
+int serena_set_used_color(serena_state_t* state, bitmap_t* used_color_bitmap)
+{
+  memcpy(&(state->used_color_bitmap), used_color_bitmap, sizeof(bitmap_t));
+  state->has_used_color = HIPSENS_TRUE;
+  if (state->last_nb_color != 0)
+    serena_set_final_color(state); /* now with the compact colors */
+  return bitmap_count_bit_lower_than(used_color_bitmap, NB_COLOR_MAX);
+}
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+/* is the slot of `color1' before the slot of `color2' in the cycle ? */
+static hipsens_bool serena_is_slot_before(serena_state_t* state,
+					  int color1, int color2)
+{
+  if (state->config->slot_order == Slot_order_children_first)
+    return color1 > color2;
+  else return color1 < color2;
+}
+
+int serena_get_subtree_latency(serena_state_t* state)
+{
+  if (state->color == COLOR_NONE)
+    return -1;
+  int result = 0;
+  int i;
+  for (i=0; i<state->nb_neighbor; i++) {
+    serena_neighbor_t* neighbor = &state->neighbor_table[i];
+    if (!neighbor->is_child)
+      continue;
+    if (!neighbor->has_sent_max_color || neighbor->color == COLOR_NONE)
+      return -1;
+    int latency = neighbor->child_latency;
+    if (!serena_is_slot_before(state, neighbor->color, state->color))
+      latency++; /* the packet waits for the next cycle */
+    if (latency > result)
+      result = latency;
+  }
+  return result;
+}
+
+static void serena_set_final_color(serena_state_t* state);
+
+void serena_set_tree_nb_color(serena_state_t* state, int tree_nb_color)
+{
+  state->tree_nb_color = tree_nb_color;
+  if (state->last_nb_color != 0)
+    serena_set_final_color(state); /* now in the order `slot_order' */
+}
+#endif /* WITH_OPERA_SLOT_ORDER */
+
+int serena_set_tree_info(serena_state_t* state, int nb_color)
+{
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  /* remove the colors that no node of the tree uses */
+  bitmap_t used_color_bitmap;
+  if (state->has_used_color)
+    nb_color = bitmap_count_bit_lower_than(&(state->used_color_bitmap),
+					   NB_COLOR_MAX);
+  else if (serena_get_subtree_color(state, &used_color_bitmap))
+    nb_color = serena_set_used_color(state, &used_color_bitmap);
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  /* the MAC is given the number of slots */
+  nb_color = serena_get_nb_channel_slot(state, nb_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+  /* disseminated in the Color messages, for the order of the slots */
+  if (state->tree_nb_color != nb_color)
+    serena_set_tree_nb_color(state, nb_color);
+#endif /* WITH_OPERA_SLOT_ORDER */
+  return nb_color;
+}
+
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+/* has the node the information of serena_set_tree_info, needed for its
+   final colors ? (the used colors, the nb. colors of the tree) */
+static hipsens_bool serena_has_tree_info(serena_state_t* state)
+{
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  if (!state->has_used_color)
+    return HIPSENS_FALSE;
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+  if (state->config->slot_order == Slot_order_children_first
+      && state->tree_nb_color == 0)
+    return HIPSENS_FALSE;
+#endif /* WITH_OPERA_SLOT_ORDER */
+  return HIPSENS_TRUE;
+}
+
+/* has the node, and every node of its subtree, the information of the tree ?
+   (their final colors are given only then) */
+static hipsens_bool serena_is_subtree_informed(serena_state_t* state)
+{
+  if (!serena_has_tree_info(state))
+    return HIPSENS_FALSE;
+  int i;
+  for (i=0; i<state->nb_neighbor; i++) {
+    serena_neighbor_t* neighbor = &state->neighbor_table[i];
+    if (neighbor->is_child && !neighbor->is_subtree_informed)
+      return HIPSENS_FALSE;
+  }
+  return HIPSENS_TRUE;
+}
+#endif
+
 /*---------------------------------------------------------------------------*/
 
 static hipsens_bool serena_get_color_info(serena_state_t* state, 
@@ -938,6 +1534,10 @@ static hipsens_bool serena_get_color_info(serena_state_t* state,
     serena_neighbor_t* neighbor  = &state->neighbor_table[i];
     if (neighbor->color != COLOR_NONE) {
       bitmap_set_bit(neighbor_color_bitmap, neighbor->color, state);
+#ifdef WITH_OPERA_MULTI_SLOT
+      bitmap_union(neighbor_color_bitmap, neighbor_color_bitmap,
+		   &(neighbor->node_color_bitmap));
+#endif /* WITH_OPERA_MULTI_SLOT */
     } else {
       STWARN("unexpected neighbor without color.\n");
     }
@@ -970,34 +1570,215 @@ static hipsens_bool serena_check_color_in_bitmap(serena_state_t* state,
 }
 
 
+/* the color given to the MAC (starting from 0) for the color `color' */
+static int serena_get_final_color(serena_state_t* state, int color)
+{
+  UNUSED(state);
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  color = serena_get_compact_color(state, color);
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  color = color / state->config->nb_channel; /* the slot */
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+#ifdef WITH_OPERA_SLOT_ORDER
+  if (state->config->slot_order == Slot_order_children_first) {
+    if (color >= state->tree_nb_color) {
+      STWARN("color %d above the nb. colors of the tree.\n", color);
+      return 0;
+    }
+    color = state->tree_nb_color - 1 - color;
+  }
+#endif /* WITH_OPERA_SLOT_ORDER */
+  return color;
+}
+
 static void serena_set_final_color(serena_state_t* state)
 {
   /* XXX: maybe avoid use of old api w/ bitmap (but then: need a sort) */
   color_info_t color_info;
 
   state->final_nb_neighbor_color = 0;
+#ifdef WITH_OPERA_MULTI_SLOT
+  state->final_nb_node_color = 0;
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  if (!state->has_used_color)
+    return; /* the colors are given after the compaction */
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+  if (state->config->slot_order == Slot_order_children_first
+      && state->tree_nb_color == 0)
+    return; /* the slots are given once the nb. colors of the tree is known */
+#endif /* WITH_OPERA_SLOT_ORDER */
   if (!serena_get_color_info(state, &color_info)) {
     STWARN("error while getting color information.\n");
     /* will set default color: none */
   } else {
 
       int i;
-      for (i=0;i<NB_COLOR_MAX;i++)
+      for (i=0;i<NB_COLOR_MAX;i++) {
+	int color = i;
+#ifdef WITH_OPERA_SLOT_ORDER
+	if (state->config->slot_order == Slot_order_children_first)
+	  color = NB_COLOR_MAX-1-i; /* the list stays sorted */
+#endif /* WITH_OPERA_SLOT_ORDER */
 	if (serena_check_color_in_bitmap
-	    (state, &color_info.neighbor_color_bitmap, i+1)) {
-	  if (state->final_nb_neighbor_color >= MAX_NEIGHBOR) {
+	    (state, &color_info.neighbor_color_bitmap, color+1)) {
+	  if (state->final_nb_neighbor_color
+	      >= SERENA_MAX_NEIGHBOR_COLOR(state)) {
 	    STFATAL("too many neighbor colors.\n");
 	    return;
 	  }
-	  state->final_neighbor_color_list[state->final_nb_neighbor_color] =i+1;
+#ifdef WITH_OPERA_COLOR_COMPACTION
+	  if (!bitmap_has_bit(&(state->used_color_bitmap), color)) {
+	    STWARN("neighbor color %d not used in the tree.\n", color);
+	    continue;
+	  }
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+	  state->final_neighbor_color_list[state->final_nb_neighbor_color]
+	    = serena_get_final_color(state, color)+1;
+#ifdef WITH_OPERA_MULTI_CHANNEL
+	  state->final_neighbor_channel_list[state->final_nb_neighbor_color]
+	    = color % state->config->nb_channel;
+#endif /* WITH_OPERA_MULTI_CHANNEL */
 	  state->final_nb_neighbor_color++;
 	}
-      state->final_node_color = color_info.node_color;
+      }
+#ifdef WITH_OPERA_COLOR_COMPACTION
+      if (!bitmap_has_bit(&(state->used_color_bitmap), state->color))
+	STWARN("node color %d not used in the tree.\n", state->color);
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+      state->final_node_color = serena_get_final_color(state, state->color)+1;
+#ifdef WITH_OPERA_MULTI_CHANNEL
+      state->final_node_channel = state->color % state->config->nb_channel;
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+#ifdef WITH_OPERA_MULTI_SLOT
+      for (i=0;i<NB_COLOR_MAX;i++) {
+	int color = i;
+#ifdef WITH_OPERA_SLOT_ORDER
+	if (state->config->slot_order == Slot_order_children_first)
+	  color = NB_COLOR_MAX-1-i; /* the list stays sorted */
+#endif /* WITH_OPERA_SLOT_ORDER */
+	if (bitmap_has_bit(&(state->node_color_bitmap), color)
+	    && state->final_nb_node_color < MAX_NODE_COLOR) {
+	  state->final_node_color_list[state->final_nb_node_color]
+	    = serena_get_final_color(state, color)+1;
+	  state->final_nb_node_color++;
+	}
+      }
+#endif /* WITH_OPERA_MULTI_SLOT */
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+hipsens_bool serena_is_colored(serena_state_t* state)
+{
+  return state->is_started && state->color != COLOR_NONE 
+    && state->last_nb_color != 0;
+}
+
+int serena_add_neighbor(serena_state_t* state, address_t address,
+			neighbor_id_t neighbor_id)
+{
+  if (state->nb_neighbor >= SERENA_MAX_NEIGHBOR(state)) {
+    STWARN("serena neighbor table full.\n");
+    return -1;
+  }
+  int neighbor_index = state->nb_neighbor;
+  while (neighbor_index > 0
+	 && state->neighbor_table[neighbor_index-1].neighbor_id > neighbor_id)
+    neighbor_index--;
+  if (neighbor_index < state->nb_neighbor) {
+    memmove( &state->neighbor_table[neighbor_index+1], 
+	     &state->neighbor_table[neighbor_index],
+	     (state->nb_neighbor-neighbor_index) * sizeof(serena_neighbor_t) );
+  }
+  state->nb_neighbor ++;
+
+  serena_neighbor_t* neighbor = &(state->neighbor_table[neighbor_index]);
+  memset(neighbor, 0, sizeof(serena_neighbor_t));
+  hipsens_address_copy(neighbor->address, address);
+  neighbor->neighbor_id = neighbor_id;
+  neighbor->color = COLOR_NONE;
+  SET_PRIORITY(neighbor->priority, PRIORITY_NONE);
+  neighbor->child_max_color = COLOR_NONE;
+  int j;
+  for (j=0;j<MAX_PRIO1_SIZE;j++)
+    addr_priority_init(&(neighbor->max2_prio1[j]));
+  for (j=0;j<MAX_PRIO2_SIZE;j++)
+    addr_priority_init(&(neighbor->max2_prio2[j]));
+  return neighbor_index;
+}
+
+void serena_start_repair(serena_state_t* state)
+{
+  if (!serena_is_colored(state))
+    return;
+  if (state->is_finished) {
+    state->next_msg_color_time = base_state_time_after_delay_jitter
+      (state->base, state->config->msg_color_interval,
+       state->config->max_jitter_time);
+    state->is_finished = HIPSENS_FALSE;
+  }
+  state->is_repairing = HIPSENS_TRUE;
+  state->repair_end_time = HIPSENS_TIME_ADD(state->base->current_time,
+					    state->config->repair_duration);
+}
+
+static void serena_end_repair(serena_state_t* state)
+{
+  state->is_repairing = HIPSENS_FALSE;
+  state->is_finished = HIPSENS_TRUE;
+  serena_set_final_color(state); /* with the colors of the new neighbors */
+}
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
+/*---------------------------------------------------------------------------*/
+
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+/* the next Color message is sent after `min_color_interval' when the
+   content of the message has changed (priorities or colors still
+   propagating), otherwise the interval is doubled up to
+   `max_color_interval' */
+static void serena_adapt_color_interval(serena_state_t* state,
+					hipsens_u16 hash)
+{
+  serena_config_t* config = state->config;
+  hipsens_time_t interval = 2 * state->color_interval;
+  if (hash != state->last_content_hash)
+    interval = config->min_color_interval;
+  if (interval < config->min_color_interval)
+    interval = config->min_color_interval;
+  if (interval > config->max_color_interval)
+    interval = config->max_color_interval;
+  state->last_content_hash = hash;
+  state->color_interval = interval;
+  state->next_msg_color_time = base_state_time_after_delay_jitter
+    (state->base, interval, config->max_jitter_time);
+}
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+/* a Color message is skipped when its content is the same as the one of
+   the last message sent, and no neighbor misses our information ; at most
+   `max_suppressed_color' are skipped in a row (keep-alive for losses) */
+static hipsens_bool serena_should_suppress_color(serena_state_t* state,
+						 hipsens_u16 hash)
+{
+  if (state->is_update_requested || hash != state->last_color_hash
+      || state->nb_suppressed_color >= state->config->max_suppressed_color) {
+    state->is_update_requested = HIPSENS_FALSE;
+    state->nb_suppressed_color = 0;
+    state->last_color_hash = hash;
+    return HIPSENS_FALSE;
+  }
+  state->nb_suppressed_color ++;
+  return HIPSENS_TRUE;
+}
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+
 static int serena_internal_generate_message(serena_state_t* state,
 					    buffer_t* buffer)
 {
@@ -1073,6 +1854,15 @@ static int serena_internal_generate_message(serena_state_t* state,
 
 
   if (state->last_nb_color != nb_color && state->last_nb_color != 0) {
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+    if (nb_color > state->last_nb_color) {
+      /* the local recoloring needed a new color */
+      state->last_nb_color = nb_color;
+      serena_set_final_color(state);
+      if (state->callback_max_color_increase != NULL)
+	(*state->callback_max_color_increase)(state);
+    } else if (nb_color != 0 && !state->is_repairing)
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
     STWARN("unexpected change of nb_color");
   }
 
@@ -1081,12 +1871,26 @@ static int serena_internal_generate_message(serena_state_t* state,
     serena_set_final_color(state);
   }
 
+  hipsens_bool is_tree_informed = HIPSENS_TRUE;
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+  /* on the root: the information of the tree is repeated in the Color
+     messages until the whole tree has it, before the coloring is finished */
   if (nb_color>0 && state->callback_coloring_finished != NULL) {
+    serena_set_tree_info(state, nb_color);
+    is_tree_informed = serena_is_subtree_informed(state);
+  }
+#endif
+
+  if (nb_color>0 && state->callback_coloring_finished != NULL
+      && is_tree_informed) {
     (*state->callback_coloring_finished)(state);
     state->callback_coloring_finished = NULL;
   }
 
   buffer_put_u8(buffer, nb_color);
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  buffer_put_u8(buffer, SERENA_CONFLICT_DISTANCE(state->config));
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
   buffer_put_u8(buffer, state->color);
   buffer_put_PRIORITY(buffer, state->priority);
 
@@ -1101,23 +1905,58 @@ static int serena_internal_generate_message(serena_state_t* state,
     buffer_put_data(buffer, local_max2_prio1[i].address, ADDRESS_SIZE);
   }
 
-  int nb_max2_prio2 = 0;
-  if (serena_has_all_neigh_prio1(state))
-    nb_max2_prio2 = count_max2_prio(MAX_PRIO2_SIZE, local_max2_prio2);
-  buffer_put_byte(buffer, nb_max2_prio2);
-  for (i=0; i<nb_max2_prio2; i++) {
-    buffer_put_PRIORITY(buffer, local_max2_prio2[i].priority);
-    buffer_put_data(buffer, local_max2_prio2[i].address, ADDRESS_SIZE);
+  if (SERENA_CONFLICT_DISTANCE(state->config) >= 3) {
+    int nb_max2_prio2 = 0;
+    if (serena_has_all_neigh_prio1(state))
+      nb_max2_prio2 = count_max2_prio(MAX_PRIO2_SIZE, local_max2_prio2);
+    buffer_put_byte(buffer, nb_max2_prio2);
+    for (i=0; i<nb_max2_prio2; i++) {
+      buffer_put_PRIORITY(buffer, local_max2_prio2[i].priority);
+      buffer_put_data(buffer, local_max2_prio2[i].address, ADDRESS_SIZE);
+    }
   }
 
   /* msg: color information */
   buffer_put_bitmap(buffer, &(state->color_bitmap1));
-  buffer_put_bitmap(buffer, &(state->color_bitmap2));
+  if (SERENA_CONFLICT_DISTANCE(state->config) >= 3)
+    buffer_put_bitmap(buffer, &(state->color_bitmap2));
 
   /* msg: sequence number */
+#if defined(WITH_OPERA_COLOR_SUPPRESSION) \
+  || defined(WITH_OPERA_ADAPTIVE_COLOR_INTERVAL)
+  int seq_num_pos = buffer->pos; /* not in the hash of the content */
+#endif
   buffer_put_u16(buffer, state->color_seq_num);
   state->color_seq_num ++;
 
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  /* msg: colors used in the subtree, and in the tree (once known) */
+  bitmap_t subtree_color_bitmap;
+  if (nb_color == 0 || !serena_get_subtree_color(state, &subtree_color_bitmap))
+    bitmap_init(&subtree_color_bitmap);
+  buffer_put_bitmap(buffer, &subtree_color_bitmap);
+  if (state->has_used_color)
+    buffer_put_bitmap(buffer, &(state->used_color_bitmap));
+  else buffer_put_u8(buffer, 0);
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+  /* msg: nb. colors of the tree (once known), latency of the subtree */
+  int subtree_latency = (nb_color > 0) ? serena_get_subtree_latency(state) : 0;
+  buffer_put_u8(buffer, state->tree_nb_color);
+  buffer_put_u8(buffer, (subtree_latency > 0) ? subtree_latency : 0);
+#endif /* WITH_OPERA_SLOT_ORDER */
+
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+  /* msg: whether the whole subtree has the information of the tree */
+  buffer_put_u8(buffer, serena_is_subtree_informed(state));
+#endif
+
+#ifdef WITH_OPERA_MULTI_SLOT
+  /* msg: all the colors of the node */
+  buffer_put_bitmap(buffer, &(state->node_color_bitmap));
+#endif /* WITH_OPERA_MULTI_SLOT */
+
   /* check buffer ok */
   if (buffer->status != HIPSENS_TRUE) {
     WARN(state->base, "packet buffer too small\n");
@@ -1131,7 +1970,28 @@ static int serena_internal_generate_message(serena_state_t* state,
   buffer_put_u8(buffer, result - msg_content_start_pos);
   buffer->pos = result; /* restore buffer size */
 
+#if defined(WITH_OPERA_COLOR_SUPPRESSION) \
+  || defined(WITH_OPERA_ADAPTIVE_COLOR_INTERVAL)
+  hipsens_u16 hash = data_checksum(0, buffer->data, seq_num_pos);
+  hash = data_checksum(hash, buffer->data + seq_num_pos + 2,
+		       result - seq_num_pos - 2);
+#endif
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  serena_adapt_color_interval(state, hash);
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  if (serena_should_suppress_color(state, hash)) {
+    state->color_seq_num --; /* not sent */
+    STLOG(DBGsrn, "msg-suppressed\n");
+    STMETRIC_INC(OPERA_METRIC_COLOR_SUPPRESSED);
+    return 0;
+  }
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+
   STLOG(DBGsrn, "msg-size=%d\n", result);
+  STTRACE(OPERA_TRACE_SERENA_COLOR_GENERATED, state->color_seq_num-1,
+	  state->color, result);
+  STMETRIC_INC(OPERA_METRIC_COLOR_GENERATED);
   
   return result;
 }
@@ -1195,10 +2055,21 @@ int serena_notify_wakeup(serena_state_t* state,
   if (HIPSENS_TIME_COMPARE_LARGE_UNDEF
       (state->base->current_time, <, state->next_msg_color_time))
     return 0;
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  if (state->is_repairing && HIPSENS_TIME_COMPARE_LARGE_UNDEF
+      (state->base->current_time, >=, state->repair_end_time)) {
+    serena_end_repair(state);
+    return 0;
+  }
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
 
   /* generate a color message if time has come */
   int packet_size = serena_generate_message(state, (byte*)packet,
 					    max_packet_size);
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  if (packet_size == 0)
+    return 0; /* unchanged message, skipped */
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
   if (packet_size <= 0) {
     STWARN("serena_notify_wakeup: msg color generation failed\n"); 
     return 0;
@@ -1222,6 +2093,15 @@ int serena_notify_wakeup(serena_state_t* state,
 //#endif
 //}
 
+#ifdef WITH_OPERA_TX_SCHEDULER
+hipsens_time_t serena_get_next_color_time(serena_state_t* state)
+{
+  if (!state->is_started || state->is_finished)
+    return undefined_time;
+  return state->next_msg_color_time;
+}
+#endif /* WITH_OPERA_TX_SCHEDULER */
+
 /*---------------------------------------------------------------------------*/
 
 #if defined(WITHOUT_LOSS) && defined(WITH_SIMUL)
@@ -1536,6 +2416,10 @@ void serena_pywrite(outstream_t out, serena_state_t* state)
 
   FPRINTF(out, ",\n  'bitmap3':");
   bitmap_PYWRITE(out, state->color_bitmap3);
+#ifdef WITH_OPERA_MULTI_SLOT
+  FPRINTF(out, ",\n  'nodeColors':");
+  bitmap_PYWRITE(out, state->node_color_bitmap);
+#endif /* WITH_OPERA_MULTI_SLOT */
 
 #ifdef DBG_SERENA
   FPRINTF(out, ",\n  'max2_prio1':");
@@ -1568,6 +2452,10 @@ void serena_pywrite(outstream_t out, serena_state_t* state)
   FPRINTF(out, ",\n  'coloringTime': " FMT_HST, state->coloring_time);
 #endif
   FPRINTF(out, ",\n 'lastNbColor':%d", state->last_nb_color);
+#ifdef WITH_OPERA_SLOT_ORDER
+  FPRINTF(out, ",\n 'treeNbColor':%d", state->tree_nb_color);
+  FPRINTF(out, ",\n 'subtreeLatency':%d", serena_get_subtree_latency(state));
+#endif /* WITH_OPERA_SLOT_ORDER */
 
   FPRINTF(out, ",\n  'neighborTable':[");
   int i;
@@ -1603,6 +2491,10 @@ void serena_pywrite(outstream_t out, serena_state_t* state)
     if (neighbor->color == COLOR_NONE)
       FPRINTF(out, "None");
     else FPRINTF(out, "%d", neighbor->color); 
+#ifdef WITH_OPERA_MULTI_SLOT
+    FPRINTF(out, ", 'nodeColors':");
+    bitmap_PYWRITE(out, neighbor->node_color_bitmap);
+#endif /* WITH_OPERA_MULTI_SLOT */
     FPRINTF(out, "}");
   }
   FPRINTF(out, "\n    ]\n  }\n");
@@ -35,11 +35,40 @@
 #define MAX_PRIO2_SIZE 3
 #define MAX_PRIO3_SIZE 1
 
+#if defined(WITH_OPERA_LOCAL_RECOLORING) && defined(WITH_OPERA_COLOR_COMPACTION)
+#error "WITH_OPERA_LOCAL_RECOLORING and WITH_OPERA_COLOR_COMPACTION are incompatible"
+#endif
+#if defined(WITH_OPERA_LOCAL_RECOLORING) && defined(WITH_OPERA_SLOT_ORDER)
+#error "WITH_OPERA_LOCAL_RECOLORING and WITH_OPERA_SLOT_ORDER are incompatible"
+#endif
+#if defined(WITH_OPERA_MULTI_SLOT) && defined(WITH_OPERA_CENTRAL_COLORING)
+#error "WITH_OPERA_MULTI_SLOT and WITH_OPERA_CENTRAL_COLORING are incompatible"
+#endif
+#if defined(WITH_OPERA_MULTI_CHANNEL) \
+  && (defined(WITH_OPERA_CENTRAL_COLORING) \
+      || defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_MULTI_SLOT))
+#error "WITH_OPERA_MULTI_CHANNEL is incompatible with WITH_OPERA_CENTRAL_COLORING, WITH_OPERA_COLOR_COMPACTION and WITH_OPERA_MULTI_SLOT"
+#endif
+#if defined(WITH_OPERA_MULTI_SLOT) && !defined(WITH_SIMUL)
+#error "WITH_OPERA_MULTI_SLOT is for the simulation only: MaCARI has one slot per node (no hipsens_api_set_node_color_list)"
+#endif
+#if defined(WITH_OPERA_MULTI_CHANNEL) && !defined(WITH_SIMUL)
+#error "WITH_OPERA_MULTI_CHANNEL is for the simulation only: MaCARI has one channel (no hipsens_api_set_channel_info)"
+#endif
+
 #ifndef NB_COLOR_MAX
 #warning NB_COLOR_MAX was not defined using default value
 #define NB_COLOR_MAX 128
 #endif
 
+#ifdef WITH_OPERA_MULTI_SLOT
+#ifndef MAX_NODE_COLOR
+#define MAX_NODE_COLOR 4 /**< max. colors (slots) of one node */
+#endif
+#else
+#define MAX_NODE_COLOR 1
+#endif /* WITH_OPERA_MULTI_SLOT */
+
 #define COLOR_NONE 0xffu
 #define PRIORITY_NONE 0
 
@@ -118,6 +147,7 @@ typedef struct s_addr_priority_t {
 
 typedef struct s_serena_neighbor_t {
   address_t address; /**< externally set */
+  neighbor_id_t neighbor_id; /**< externally set: identifier in EOND */
   byte color;     /**< the color of the neighbor */
   priority_t priority; /**< coloring priority of the node w.r.t other nodes */
   /** MAX_PRIO1_SIZE most prioritary 1-hop neighbors */
@@ -135,6 +165,18 @@ typedef struct s_serena_neighbor_t {
   byte is_parent:1; /**< externally set */
   byte has_sent_max_color:1; 
   byte child_max_color; /*< XXX */
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  bitmap_t child_color_bitmap; /**< colors used in the subtree of the child */
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+  byte child_latency; /**< see serena_get_subtree_latency, of the child */
+#endif /* WITH_OPERA_SLOT_ORDER */
+#if defined(WITH_OPERA_COLOR_COMPACTION) || defined(WITH_OPERA_SLOT_ORDER)
+  byte is_subtree_informed:1; /**< has its subtree serena_set_tree_info's? */
+#endif
+#ifdef WITH_OPERA_MULTI_SLOT
+  bitmap_t node_color_bitmap; /**< all the colors of the neighbor */
+#endif /* WITH_OPERA_MULTI_SLOT */
   /* hipsens_u16 child_seq_num; **< XXX remove ? */
 } serena_neighbor_t;
 
@@ -152,6 +194,15 @@ typedef enum {
 #endif
 } priority_mode_t;
 
+#ifdef WITH_OPERA_SLOT_ORDER
+/* order of the slots given to the MAC ; with Priority_mode_tree,
+   the color of a child is always greater than the color of its parent */
+typedef enum {
+  Slot_order_parent_first = 0,  /**< slot = color */
+  Slot_order_children_first = 1 /**< slot = nb. colors-1-color: convergecast */
+} slot_order_t;
+#endif /* WITH_OPERA_SLOT_ORDER */
+
 typedef struct s_serena_config_t {
   /* configuration */
   hipsens_time_t max_jitter_time;
@@ -159,8 +210,56 @@ typedef struct s_serena_config_t {
   priority_mode_t priority_mode; 
   priority_t fixed_priority; /* only w/`priority_mode' == Priority_mode_fixed */
   hipsens_time_t recoloring_delay; /* XXX: should be in opera_config */
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  hipsens_bool central_coloring; /**< colors assigned by the root */
+  hipsens_time_t central_timeout; /**< then distributed coloring */
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  hipsens_time_t repair_duration; /**< Color messages after a local change */
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+#ifdef WITH_OPERA_SLOT_ORDER
+  slot_order_t slot_order;
+#endif /* WITH_OPERA_SLOT_ORDER */
+#ifdef WITH_OPERA_MULTI_SLOT
+  byte nb_slot; /**< colors taken by the node, 0: from its descendants */
+  byte nb_descendant_per_slot; /**< when `nb_slot' is 0 */
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  byte nb_channel; /**< color = slot * nb_channel + channel */
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+  byte conflict_distance; /**< 2 or 3 hops, the same on all the nodes */
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  byte max_suppressed_color; /**< unchanged Color messages skipped in a row */
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  hipsens_time_t min_color_interval; /**< while the messages change */
+  hipsens_time_t max_color_interval; /**< once they are stable */
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
 } serena_config_t;
 
+/** nodes at this distance (hops) or less get different colors */
+#ifdef WITH_OPERA_CONFLICT_DISTANCE
+#define SERENA_CONFLICT_DISTANCE(config) ((config)->conflict_distance)
+#else
+#define SERENA_CONFLICT_DISTANCE(config) 3
+#endif /* WITH_OPERA_CONFLICT_DISTANCE */
+
+/** lowest interval between two Color messages: with the TX scheduler,
+    the centralized coloring does not complete when a Color message is
+    due at every frame */
+#if defined(WITH_OPERA_CENTRAL_COLORING) && defined(WITH_OPERA_TX_SCHEDULER)
+#define SERENA_MIN_COLOR_INTERVAL 2
+#else
+#define SERENA_MIN_COLOR_INTERVAL 1
+#endif
+
+#ifdef WITH_OPERA_CENTRAL_COLORING
+/** default `central_timeout' for a Color interval */
+#define SERENA_CENTRAL_TIMEOUT(msg_color_interval) (16 * (msg_color_interval))
+#endif /* WITH_OPERA_CENTRAL_COLORING */
+
 /*--------------------------------------------------
  * The full state of an instance of the SERENA protocol
  *--------------------------------------------------*/
@@ -178,16 +277,38 @@ typedef struct s_serena_state_t {
   byte is_finished:1; /**< is coloring finished? */
   hipsens_u16 color_seq_num;
   hipsens_time_t next_msg_color_time; /**< time for next color message */
+#ifdef WITH_OPERA_COLOR_SUPPRESSION
+  byte is_update_requested:1; /**< a neighbor misses our information */
+  byte nb_suppressed_color; /**< Color messages skipped since the last one */
+  hipsens_u16 last_color_hash; /**< of the last Color message sent */
+#endif /* WITH_OPERA_COLOR_SUPPRESSION */
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+  hipsens_time_t color_interval; /**< until the next Color message */
+  hipsens_u16 last_content_hash; /**< of the last Color message generated */
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
 
   byte color;    /**< the color of the node */
   priority_t priority; /**< the priority of the node */
+#ifdef WITH_OPERA_MULTI_SLOT
+  bitmap_t node_color_bitmap; /**< all the colors of the node (with `color') */
+  hipsens_u16 nb_descendant; /**< externally set: with the node itself */
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_CENTRAL_COLORING
+  byte central_color; /**< assigned by the root, COLOR_NONE if none */
+  hipsens_time_t central_deadline; /**< end of the wait for `central_color' */
+#endif /* WITH_OPERA_CENTRAL_COLORING */
   
   bitmap_t color_bitmap1;
   bitmap_t color_bitmap2;
   bitmap_t color_bitmap3;
 
   int nb_neighbor;
+#ifdef WITH_OPERA_ARENA
+  serena_neighbor_t* neighbor_table; /**< in the arena */
+  int max_neighbor;
+#else
   serena_neighbor_t neighbor_table[MAX_NEIGHBOR];
+#endif
 
   /* information about the tree */
   address_t root_address;
@@ -202,6 +323,13 @@ typedef struct s_serena_state_t {
   hipsens_time_t coloring_time;
 #endif /* DBG_SERENA */
   byte last_nb_color; /* last_nb_color sent */
+#ifdef WITH_OPERA_COLOR_COMPACTION
+  byte has_used_color:1; /**< is `used_color_bitmap' known? */
+  bitmap_t used_color_bitmap; /**< colors used in the tree, from the root */
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+#ifdef WITH_OPERA_SLOT_ORDER
+  byte tree_nb_color; /**< nb. colors of the tree, from the root, 0 if unknown */
+#endif /* WITH_OPERA_SLOT_ORDER */
 
 #ifdef IMPLICIT_COLORING_DETECTION
 #define MAX_IMPLICIT_COLORED 10
@@ -220,16 +348,51 @@ typedef struct s_serena_state_t {
   int size_sent_msg;
 #endif
   callback_coloring_finished_t* callback_coloring_finished;
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+  callback_coloring_finished_t* callback_max_color_increase;
+  byte is_repairing:1; /**< colored, but sending Color messages again */
+  hipsens_time_t repair_end_time;
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
 
   /* final color information passed as-is */
   byte final_nb_neighbor_color; /* if != 0 then the node is colored */
-  byte final_neighbor_color_list[MAX_NEIGHBOR];
+#ifdef WITH_OPERA_ARENA
+  byte* final_neighbor_color_list; /**< in the arena */
+#else
+  byte final_neighbor_color_list[MAX_NEIGHBOR*MAX_NODE_COLOR];
+#endif
   byte final_node_color; 
+#ifdef WITH_OPERA_MULTI_SLOT
+  byte final_nb_node_color; /**< with `final_node_color' */
+  byte final_node_color_list[MAX_NODE_COLOR];
+#endif /* WITH_OPERA_MULTI_SLOT */
+#ifdef WITH_OPERA_MULTI_CHANNEL
+  /* with WITH_OPERA_MULTI_CHANNEL, the final colors are the slots */
+  byte final_node_channel; /**< counting from 0 */
+#ifdef WITH_OPERA_ARENA
+  byte* final_neighbor_channel_list; /**< in the arena */
+#else
+  /** the channel of each slot of `final_neighbor_color_list' */
+  byte final_neighbor_channel_list[MAX_NEIGHBOR*MAX_NODE_COLOR];
+#endif
+#endif /* WITH_OPERA_MULTI_CHANNEL */
 } serena_state_t;
 
+#ifdef WITH_OPERA_ARENA
+#define SERENA_MAX_NEIGHBOR(state) ((state)->max_neighbor)
+#else
+#define SERENA_MAX_NEIGHBOR(state) MAX_NEIGHBOR
+#endif
+/** size of `final_neighbor_color_list' */
+#define SERENA_MAX_NEIGHBOR_COLOR(state) \
+  (SERENA_MAX_NEIGHBOR(state)*MAX_NODE_COLOR)
+
 /*---------------------------------------------------------------------------*/
 
 void serena_config_init_default(serena_config_t* config);
+#ifdef WITH_OPERA_ADAPTIVE_COLOR_INTERVAL
+void serena_config_set_color_interval_bounds(serena_config_t* config);
+#endif /* WITH_OPERA_ADAPTIVE_COLOR_INTERVAL */
 
 void new__serena_state_init(serena_state_t* state, base_state_t* base,
 			    serena_config_t* config);
@@ -244,14 +407,71 @@ void serena_get_next_wakeup_condition(serena_state_t* state,
 				      hipsens_wakeup_condition_t* condition);
 int serena_notify_wakeup(serena_state_t* state, 
 			 void* packet, int max_packet_size);
+#ifdef WITH_OPERA_TX_SCHEDULER
+/* time at which a Color message should be generated */
+hipsens_time_t serena_get_next_color_time(serena_state_t* state);
+#endif /* WITH_OPERA_TX_SCHEDULER */
 
 int serena_find_neighbor_index(serena_state_t* state, address_t address); //added-ridha
 void serena_remove_neighbor(serena_state_t* state, int neighbor_index); //added-ridha
+
+/** return the index in neighbor_table, or -1 ; the table must be sorted
+    by increasing `neighbor_id' (as set by opera_set_serena_topology_info) */
+int serena_find_neighbor_index_by_id(serena_state_t* state,
+				     neighbor_id_t neighbor_id);
 int hipsens_seqnum_cmp(hipsens_u16 s1, hipsens_u16 s2);//added-ridha
 
 
 int serena_get_nb_color(serena_state_t* state); //added-ridha
 
+#ifdef WITH_OPERA_COLOR_COMPACTION
+/** set `result' to the colors used by the node and its subtree,
+    return HIPSENS_FALSE if they are not yet known (as serena_get_nb_color) */
+hipsens_bool serena_get_subtree_color(serena_state_t* state, bitmap_t* result);
+
+/** set the colors used in the whole tree (on the root, or from the parent):
+    the final colors are then renumbered into 0..(nb. used colors - 1),
+    keeping their order. Returns the number of used colors. */
+int serena_set_used_color(serena_state_t* state, bitmap_t* used_color_bitmap);
+#endif /* WITH_OPERA_COLOR_COMPACTION */
+
+#ifdef WITH_OPERA_MULTI_CHANNEL
+/** number of slots for the colors 0..`nb_color'-1 */
+int serena_get_nb_channel_slot(serena_state_t* state, int nb_color);
+#endif /* WITH_OPERA_MULTI_CHANNEL */
+
+#ifdef WITH_OPERA_SLOT_ORDER
+/** return the worst number of cycles lost by a packet sent from the subtree
+    of the node to the node, that is, the max. number of hops where the slot
+    of a child is not before the slot of its parent ; -1 if not yet known
+    (as serena_get_nb_color) */
+int serena_get_subtree_latency(serena_state_t* state);
+
+/** set the number of colors of the tree (on the root, or from the parent):
+    the final colors are then given in the order `slot_order' */
+void serena_set_tree_nb_color(serena_state_t* state, int tree_nb_color);
+#endif /* WITH_OPERA_SLOT_ORDER */
+
+/** on the root, once the tree is colored (`nb_color' > 0): set the
+    information disseminated to the whole tree (used colors, nb. colors
+    of the tree), return the number of colors (or slots) for the MAC */
+int serena_set_tree_info(serena_state_t* state, int nb_color);
+
+#ifdef WITH_OPERA_LOCAL_RECOLORING
+/** has the node a color, and known colors for its neighbors and subtree? */
+hipsens_bool serena_is_colored(serena_state_t* state);
+
+/** add a neighbor (without color) to the table of a colored node ; the
+    table stays sorted by `neighbor_id'. Returns its index or -1 if full. */
+int serena_add_neighbor(serena_state_t* state, address_t address,
+			neighbor_id_t neighbor_id);
+
+/** the node keeps its color, but sends Color messages again until
+    `repair_duration' after the last local change (new neighbor, new colors
+    at 1 or 2 hops, new max color of a child) */
+void serena_start_repair(serena_state_t* state);
+#endif /* WITH_OPERA_LOCAL_RECOLORING */
+
 #ifdef WITH_PRINTF
 void serena_dump(serena_state_t* state);
 void serena_pydump(serena_state_t* state);
@@ -0,0 +1,307 @@
+/*---------------------------------------------------------------------------
+ *                  OPERA - Binary State Snapshot
+ *---------------------------------------------------------------------------
+ * Author: agent
+ * Copyright 2026 agent.
+ *
+ * This file is part of the OPERA.
+ *
+ * The OPERA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * The OPERA is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+ * http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *---------------------------------------------------------------------------*/
+
+#include "hipsens-all.h"
+
+#ifdef WITH_OPERA_SNAPSHOT
+
+/*---------------------------------------------------------------------------*/
+
+/*
+  Content of the sections (version 2), 'time' are 4 bytes (hipsens_time_t),
+  'prio' are 4 bytes (whatever WITH_LONG_PRIORITY is), 'addr' are
+  ADDRESS_SIZE bytes:
+
+  'O' (opera):  flags(1) wakeup_time wakeup_time_buffer cycle_transmit_count(1)
+                energy_class(1) warning_count(1) error_count(1)
+  'H' (eond):   hello_seq_num(2) next_msg_hello_time has_changed(1)
+                nb_neighbor(2) then for each non-empty entry:
+                  addr state(1) sym_time asym_time nb_1hop(1) energy_class(1)
+  'S' (eostc):  next_msg_stc_time my_tree_index(2) nb_tree(2) then for each
+                non-empty tree:
+                  index(2) status(1) root_addr stc_seq_num(2) parent_addr
+                  cost(2) validity_time received_vtime(1) ttl(1)
+                  is_serena(1) and, if is_serena:
+                    flags(1) state_bits(1) stability_time tree_seq_num(2)
+                    nb_child(2) then for each child:
+                      addr nb_descendant(2) status(1) validity_time
+  'C' (serena): state_bits(1) color_seq_num(2) next_msg_color_time color(1)
+                prio root_addr tree_seq_num(2) last_nb_color(1)
+                final_node_color(1) final_nb_neighbor_color(1) + list(1 each)
+                bitmap_size(1) bitmap1 bitmap2 bitmap3
+                nb_neighbor(2) then for each neighbor:
+                  addr color(1) prio neighbor_bits(1) child_max_color(1)
+                  MAX_PRIO1_SIZE(1) x (addr prio)
+                  MAX_PRIO2_SIZE(1) x (addr prio)
+*/
+
+#define buffer_put_TIME(buffer, time) \
+  buffer_put_u32((buffer), (hipsens_u32)(time))
+
+#define buffer_put_SNAPSHOT_PRIORITY(buffer, priority) \
+  buffer_put_u32((buffer), (hipsens_u32)GET_PRIORITY(priority))
+
+/** starts a section, returns the position of its size field */
+static int snapshot_begin_section(buffer_t* buffer, byte tag)
+{
+  buffer_put_u8(buffer, tag);
+  int size_pos = buffer->pos;
+  buffer_put_u16(buffer, 0); /* size, filled in snapshot_end_section */
+  return size_pos;
+}
+
+static void snapshot_end_section(buffer_t* buffer, int size_pos)
+{
+  if (buffer->status != HIPSENS_TRUE)
+    return;
+  int end_pos = buffer->pos;
+  buffer->pos = size_pos;
+  buffer_put_u16(buffer, end_pos - size_pos - 2);
+  buffer->pos = end_pos;
+}
+
+/** overwrite a u16 written earlier (used for counts) */
+static void snapshot_patch_u16(buffer_t* buffer, int pos, hipsens_u16 value)
+{
+  if (buffer->status != HIPSENS_TRUE)
+    return;
+  int end_pos = buffer->pos;
+  buffer->pos = pos;
+  buffer_put_u16(buffer, value);
+  buffer->pos = end_pos;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static void snapshot_put_opera(buffer_t* buffer, opera_state_t* state)
+{
+  int size_pos = snapshot_begin_section(buffer, OPERA_SNAPSHOT_SECTION_OPERA);
+  hipsens_u8 flags = ( (state->is_colored_tree_root << 0)
+		       | (state->has_set_color << 1)
+		       | (state->should_start_serena << 2)
+		       | (state->is_blocked << 3)
+		       | (state->should_be_reset << 4)
+		       | (state->should_inc_colored_tree_seq << 5)
+		       | (state->should_stop_stc_generation << 6) );
+  buffer_put_u8(buffer, flags);
+  buffer_put_TIME(buffer, state->wakeup_condition.wakeup_time);
+  buffer_put_TIME(buffer, state->wakeup_condition.wakeup_time_buffer);
+  buffer_put_u8(buffer, state->cycle_transmit_count);
+#ifdef WITH_ENERGY
+  buffer_put_u8(buffer, state->base_state.energy_class);
+#else
+  buffer_put_u8(buffer, 0);
+#endif /* WITH_ENERGY */
+  buffer_put_u8(buffer, state->base_state.warning_count);
+  buffer_put_u8(buffer, state->base_state.error_count);
+  snapshot_end_section(buffer, size_pos);
+}
+
+static void snapshot_put_eond(buffer_t* buffer, eond_state_t* state)
+{
+  int size_pos = snapshot_begin_section(buffer, OPERA_SNAPSHOT_SECTION_EOND);
+  buffer_put_u16(buffer, state->hello_seq_num);
+  buffer_put_TIME(buffer, state->next_msg_hello_time);
+  buffer_put_u8(buffer, state->has_neighborhood_changed);
+
+  int count_pos = buffer->pos;
+  int count = 0;
+  int i;
+  buffer_put_u16(buffer, 0); /* nb_neighbor, filled later */
+  for (i=0; i<EOND_MAX_NEIGHBOR(state); i++) {
+    eond_neighbor_t* neighbor = &(state->neighbor_table[i]);
+    if (neighbor->state == EOND_None)
+      continue;
+    buffer_put_ADDRESS(buffer, neighbor->address);
+    buffer_put_u8(buffer, neighbor->state);
+    buffer_put_TIME(buffer, neighbor->sym_time);
+    buffer_put_TIME(buffer, neighbor->asym_time);
+    buffer_put_u8(buffer, neighbor->nb_1hop);
+#ifdef WITH_ENERGY
+    buffer_put_u8(buffer, neighbor->energy_class);
+#else
+    buffer_put_u8(buffer, 0);
+#endif /* WITH_ENERGY */
+    count++;
+  }
+  snapshot_patch_u16(buffer, count_pos, count);
+  snapshot_end_section(buffer, size_pos);
+}
+
+static void snapshot_put_serena_tree(buffer_t* buffer, eostc_state_t* state,
+				     eostc_serena_tree_t* serena_tree)
+{
+  buffer_put_u8(buffer, serena_tree->flags);
+  buffer_put_u8(buffer, ( (serena_tree->should_generate_tree_status << 0)
+			  | (serena_tree->limit_tree_status << 1)
+			  | (serena_tree->is_subtree_stable << 2)
+			  | (serena_tree->is_neighborhood_stable << 3)
+			  | (serena_tree->has_sent_stable << 4) ));
+  buffer_put_TIME(buffer, serena_tree->stability_time);
+  buffer_put_u16(buffer, serena_tree->tree_seq_num);
+
+  int count_pos = buffer->pos;
+  int count = 0;
+  int i;
+  buffer_put_u16(buffer, 0); /* nb_child, filled later */
+  for (i=0; i<EOSTC_MAX_CHILD(serena_tree); i++) {
+    eostc_child_t* child = &(serena_tree->child[i]);
+    if (child->status == Child_None)
+      continue;
+    buffer_put_ADDRESS(buffer, EOSTC_CHILD_ADDRESS(state, child));
+    buffer_put_u16(buffer, child->nb_descendant);
+    buffer_put_u8(buffer, child->status);
+    buffer_put_TIME(buffer, child->validity_time);
+    count++;
+  }
+  snapshot_patch_u16(buffer, count_pos, count);
+}
+
+static void snapshot_put_eostc(buffer_t* buffer, eostc_state_t* state)
+{
+  int size_pos = snapshot_begin_section(buffer, OPERA_SNAPSHOT_SECTION_EOSTC);
+  buffer_put_TIME(buffer, state->next_msg_stc_time);
+  if (state->my_tree != NULL)
+    buffer_put_u16(buffer, state->my_tree - state->tree);
+  else buffer_put_u16(buffer, 0xffffu);
+
+  int count_pos = buffer->pos;
+  int count = 0;
+  int i;
+  buffer_put_u16(buffer, 0); /* nb_tree, filled later */
+  for (i=0; i<EOSTC_MAX_TREE(state); i++) {
+    eostc_tree_t* tree = &(state->tree[i]);
+    if (tree->status == EOSTC_None)
+      continue;
+    buffer_put_u16(buffer, i);
+    buffer_put_u8(buffer, tree->status);
+    buffer_put_ADDRESS(buffer, tree->root_address);
+    buffer_put_u16(buffer, tree->stc_seq_num);
+    buffer_put_ADDRESS(buffer, tree->parent_address);
+    buffer_put_u16(buffer, tree->current_cost);
+    buffer_put_TIME(buffer, tree->validity_time);
+    buffer_put_u8(buffer, tree->received_vtime);
+    buffer_put_u8(buffer, tree->ttl_if_generate);
+    buffer_put_u8(buffer, IS_FOR_SERENA(*tree));
+    if (IS_FOR_SERENA(*tree))
+      snapshot_put_serena_tree(buffer, state, tree->serena_info);
+    count++;
+  }
+  snapshot_patch_u16(buffer, count_pos, count);
+  snapshot_end_section(buffer, size_pos);
+}
+
+static void snapshot_put_addr_priority_list(buffer_t* buffer,
+					    addr_priority_t* list, int size)
+{
+  int i;
+  buffer_put_u8(buffer, size);
+  for (i=0; i<size; i++) {
+    buffer_put_ADDRESS(buffer, list[i].address);
+    buffer_put_SNAPSHOT_PRIORITY(buffer, list[i].priority);
+  }
+}
+
+static void snapshot_put_serena(buffer_t* buffer, serena_state_t* state)
+{
+  int size_pos = snapshot_begin_section(buffer,OPERA_SNAPSHOT_SECTION_SERENA);
+  int i;
+  buffer_put_u8(buffer, ( (state->is_started << 0)
+			  | (state->is_topology_set << 1)
+			  | (state->is_finished << 2) ));
+  buffer_put_u16(buffer, state->color_seq_num);
+  buffer_put_TIME(buffer, state->next_msg_color_time);
+  buffer_put_u8(buffer, state->color);
+  buffer_put_SNAPSHOT_PRIORITY(buffer, state->priority);
+  buffer_put_ADDRESS(buffer, state->root_address);
+  buffer_put_u16(buffer, state->tree_seq_num);
+  buffer_put_u8(buffer, state->last_nb_color);
+
+  buffer_put_u8(buffer, state->final_node_color);
+  buffer_put_u8(buffer, state->final_nb_neighbor_color);
+  buffer_put_data(buffer, state->final_neighbor_color_list,
+		  state->final_nb_neighbor_color);
+
+  buffer_put_u8(buffer, BYTES_PER_BITMAP);
+  buffer_put_data(buffer, state->color_bitmap1.content, BYTES_PER_BITMAP);
+  buffer_put_data(buffer, state->color_bitmap2.content, BYTES_PER_BITMAP);
+  buffer_put_data(buffer, state->color_bitmap3.content, BYTES_PER_BITMAP);
+
+  buffer_put_u16(buffer, state->nb_neighbor);
+  for (i=0; i<state->nb_neighbor; i++) {
+    serena_neighbor_t* neighbor = &(state->neighbor_table[i]);
+    buffer_put_ADDRESS(buffer, neighbor->address);
+    buffer_put_u8(buffer, neighbor->color);
+    buffer_put_SNAPSHOT_PRIORITY(buffer, neighbor->priority);
+    buffer_put_u8(buffer, ( (neighbor->has_prio << 0)
+			    | (neighbor->has_prio1 << 1)
+			    | (neighbor->has_prio2 << 2)
+			    | (neighbor->is_child << 3)
+			    | (neighbor->is_parent << 4)
+			    | (neighbor->has_sent_max_color << 5) ));
+    buffer_put_u8(buffer, neighbor->child_max_color);
+    snapshot_put_addr_priority_list(buffer, neighbor->max2_prio1,
+				    MAX_PRIO1_SIZE);
+    snapshot_put_addr_priority_list(buffer, neighbor->max2_prio2,
+				    MAX_PRIO2_SIZE);
+  }
+  snapshot_end_section(buffer, size_pos);
+}
+
+/*---------------------------------------------------------------------------*/
+
+int opera_snapshot_write(opera_state_t* state, byte* data, int max_size)
+{
+  HIPSENS_GET_MY_ADDRESS(state->base, my_address);
+  buffer_t buffer;
+  buffer_init(&buffer, data, max_size);
+
+  /* --- header */
+  buffer_put_u8(&buffer, OPERA_SNAPSHOT_MAGIC_1);
+  buffer_put_u8(&buffer, OPERA_SNAPSHOT_MAGIC_2);
+  buffer_put_u8(&buffer, OPERA_SNAPSHOT_VERSION);
+  buffer_put_u8(&buffer, ADDRESS_SIZE);
+  int total_size_pos = buffer.pos;
+  buffer_put_u16(&buffer, 0); /* total size, filled later */
+  buffer_put_ADDRESS(&buffer, my_address);
+  buffer_put_TIME(&buffer, state->base_state.current_time);
+
+  /* --- sections */
+  snapshot_put_opera(&buffer, state);
+  snapshot_put_eond(&buffer, &state->eond_state);
+  snapshot_put_eostc(&buffer, &state->eostc_state);
+  snapshot_put_serena(&buffer, &state->serena_state);
+
+  if (buffer.status != HIPSENS_TRUE || buffer.pos > 0xffff)
+    return OPERA_SNAPSHOT_BAD_SIZE;
+
+  int result = buffer.pos;
+  buffer.pos = total_size_pos;
+  buffer_put_u16(&buffer, result);
+  return result;
+}
+
+/*---------------------------------------------------------------------------*/
+
+#endif /* WITH_OPERA_SNAPSHOT */
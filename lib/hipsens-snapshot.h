@@ -0,0 +1,76 @@
+/*---------------------------------------------------------------------------
+ *                  OPERA - Binary State Snapshot
+ *---------------------------------------------------------------------------
+ * Author: agent
+ * Copyright 2026 agent.
+ *
+ * This file is part of the OPERA.
+ *
+ * The OPERA is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * The OPERA is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+ * http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *---------------------------------------------------------------------------*/
+
+/**
+ * Compact binary snapshot of an opera_state_t, intended to replace
+ * `opera_pywrite' when the state of many nodes must be observed
+ * (for instance at every cycle of a large simulation).
+ *
+ * Layout (all integers in network order, as in the OPERA messages):
+ *
+ *  +------+------+---------+----------+---------------+-----------+------
+ *  | 'O'  | 'S'  | version | addr.size| total size(2) | address   | time(4)
+ *  +------+------+---------+----------+---------------+-----------+------
+ *  followed by sections:
+ *  +-----+---------+---------------------
+ *  | tag | size(2) | content ...
+ *  +-----+---------+---------------------
+ *
+ * A reader must skip sections with an unknown tag (using their size),
+ * and must reject a snapshot with an unknown version.
+ * tools/OperaSnapshot.py is the reference reader.
+ */
+
+#ifndef _HIPSENS_SNAPSHOT_H
+#define _HIPSENS_SNAPSHOT_H
+
+/*---------------------------------------------------------------------------*/
+
+#ifdef WITH_OPERA_SNAPSHOT
+
+#define OPERA_SNAPSHOT_MAGIC_1 'O'
+#define OPERA_SNAPSHOT_MAGIC_2 'S'
+#define OPERA_SNAPSHOT_VERSION 2
+
+/* section tags */
+#define OPERA_SNAPSHOT_SECTION_OPERA  'O'
+#define OPERA_SNAPSHOT_SECTION_EOND   HIPSENS_MSG_HELLO
+#define OPERA_SNAPSHOT_SECTION_EOSTC  HIPSENS_MSG_STC
+#define OPERA_SNAPSHOT_SECTION_SERENA HIPSENS_MSG_COLOR
+
+/* error codes (returned as negative values) */
+#define OPERA_SNAPSHOT_BAD_SIZE (-1)
+
+/**
+ * Write a binary snapshot of `state' in `data'.
+ * Returns the size of the snapshot, or OPERA_SNAPSHOT_BAD_SIZE if
+ * `max_size' was too small.
+ */
+int opera_snapshot_write(opera_state_t* state, byte* data, int max_size);
+
+#endif /* WITH_OPERA_SNAPSHOT */
+
+/*---------------------------------------------------------------------------*/
+
+#endif /* _HIPSENS_SNAPSHOT_H */
@@ -28,9 +28,15 @@ try:
     import hipsens
     from hipsens import OPERA_INCREASE_TREE_SEQNUM, OPERA_CMD_GET_VERSION
     from hipsens import OPERA_ADDRESS_FILTER_SET, OPERA_ERASE_MY_TREE
+    from hipsens import OPERA_ADDRESS_FILTER_GET, OPERA_ADDRESS_FILTER_ADD
+    from hipsens import OPERA_GET_TRACE, OPERA_GET_METRICS, OPERA_GET_PROFILE
+    from hipsens import OPERA_RESET_METRICS, OPERA_RESET_PROFILE
+    from hipsens import OPERA_SET_TX_CLASS, OPERA_GET_TX_CLASS
+    from hipsens import ADDRESS_SIZE
     from hipsens import FilterOnlyAccept, FilterReject, FilterNone
 except:
-    print "*** Note: module 'hipsens' not imported, reading from 'genHipsens'"
+    print >> sys.stderr, \
+        "*** Note: module 'hipsens' not imported, reading from 'genHipsens'"
     import genHipsens as hipsens
     from genHipsens import *
     
@@ -47,12 +53,33 @@ def packCommand(data):
 def cmdVersion():
     return packCommand(p("B",OPERA_CMD_GET_VERSION))
 
+def setAddressSize(addressSize):
+    # ADDRESS_SIZE of the target, when not the one of 'hipsens'/'genHipsens'
+    global ADDRESS_SIZE
+    ADDRESS_SIZE = addressSize
+
+def packAddress(address):
+    # ADDRESS_SIZE bytes, most significant first (serial version >= 0.1)
+    if type(address) == str:
+        address = eval(address)
+    return "".join([chr((address >> (8*i)) & 0xff) 
+                    for i in reversed(range(ADDRESS_SIZE))])
+
 OperaGetCode = {}
 OperaSetCode = {}
 OperaNameList = []
 
+# commands with a specific payload (see makeCommand): not in OperaGetCode
+# nor in OperaSetCode
+OperaSpecialNameList = ["OPERA_GET_TRACE", "OPERA_GET_METRICS",
+                        "OPERA_GET_PROFILE",
+                        "OPERA_SET_TX_CLASS", "OPERA_GET_TX_CLASS"]
+
 for name in dir(hipsens):
     originalName = name
+    if name in OperaSpecialNameList:
+        OperaNameList.append(originalName)
+        continue
     if name.startswith("OPERA_GET_"):
         name = name.replace("OPERA_GET_", "")
         table = OperaGetCode
@@ -100,35 +127,71 @@ def makeCommand(*arg):
         if arg[1] == "accept": mode = FilterOnlyAccept
         elif arg[1] == "reject": mode = FilterReject
         elif arg[1] == "none": mode = FilterNone
-        addressList = [ struct.pack("!H",x) if (type(x) == type(int)) 
-                        else struct.pack("H",eval(x))
-                        for x in arg[2:] ]
-        data = "".join(addressList) #struct.pack("!H", x) for x in addressList)
+        else: raise ValueError("Unknown filter mode", arg[1])
+        data = "".join([packAddress(x) for x in arg[2:]])
         return packCommand(p("BB", OPERA_ADDRESS_FILTER_SET, mode) 
                            + data)
+    elif arg[0] == "address-filter-add":
+        data = "".join([packAddress(x) for x in arg[1:]])
+        return packCommand(p("B", OPERA_ADDRESS_FILTER_ADD) + data)
+    elif arg[0] == "address-filter-get":
+        index = 0
+        if len(arg) > 1: index = int(arg[1])
+        return packCommand(p("!BH", OPERA_ADDRESS_FILTER_GET, index))
+
+    elif arg[0] == "trace":
+        seqNum = 0 # sequence number of the first record
+        if len(arg) > 1: seqNum = int(arg[1])
+        return packCommand(p("!BH", OPERA_GET_TRACE, seqNum))
+    elif arg[0] == "metrics":
+        first = 0 # index of the first counter
+        if len(arg) > 1: first = int(arg[1])
+        return packCommand(p("BB", OPERA_GET_METRICS, first))
+    elif arg[0] == "reset-metrics":
+        return packCommand(p("B", OPERA_RESET_METRICS))
+    elif arg[0] == "profile":
+        point = int(arg[1]) # profile point, then first bucket
+        first = 0
+        if len(arg) > 2: first = int(arg[2])
+        return packCommand(p("BBB", OPERA_GET_PROFILE, point, first))
+    elif arg[0] == "reset-profile":
+        return packCommand(p("B", OPERA_RESET_PROFILE))
+    elif arg[0] == "tx-class":
+        txClass = int(arg[1]) # then priority, bucket-size, refill-interval
+        if len(arg) == 2:
+            return packCommand(p("BB", OPERA_GET_TX_CLASS, txClass))
+        priority, bucketSize, refillInterval = [int(x) for x in arg[2:5]]
+        return packCommand(p("!BBBBH", OPERA_SET_TX_CLASS, txClass,
+                             priority, bucketSize, refillInterval))
 
     else: raise ValueError("Unknown command", arg)
 
 #---------------------------------------------------------------------------
 
-def generateReplacementModule():
-    f = open("genHipsens.py", "w")
+def generateReplacementModule(f = sys.stdout):
+    # printed by default: genHipsens.py is kept by hand, and is compared
+    # with this output (generated from the real module 'hipsens')
     f.write("#--- file automatically generated by:\n")
     f.write("#---   python %s\n" % (" ".join(sys.argv)))
     for name in ["OPERA_INCREASE_TREE_SEQNUM", 
                  "OPERA_ERASE_MY_TREE",
                  "OPERA_CMD_GET_VERSION",
                  "OPERA_ADDRESS_FILTER_SET", 
+                 "OPERA_ADDRESS_FILTER_GET",
+                 "OPERA_ADDRESS_FILTER_ADD",
+                 "OPERA_RESET_METRICS", "OPERA_RESET_PROFILE",
+                 "ADDRESS_SIZE",
                  "FilterOnlyAccept", "FilterReject", "FilterNone" ]:        
         f.write("%s = %s\n" % (name, eval(name)))
     for name in OperaNameList:
         f.write("%s = %s\n" % (name, eval("hipsens."+name)))
-    f.close()
 
 #---------------------------------------------------------------------------
 
 if __name__ == "__main__":
     if "generate" in sys.argv:
+        if hipsens.__name__ != "hipsens":
+            sys.exit("module 'hipsens' not imported: nothing to generate")
         generateReplacementModule()
 
 #---------------------------------------------------------------------------
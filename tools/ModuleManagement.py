@@ -456,10 +456,14 @@ def runAsProgram(progArgList, verbose = Verbose):
                       default=DefaultFlushDuration)
     parser.add_option("-r", "--retry", dest = "retryDuration", type="float",
                       default=DefaultRetryDuration)
+    parser.add_option("-a", "--address-size", dest = "addressSize", 
+                      type="int", default=None) # ADDRESS_SIZE of the target
 
     if verbose: print "Command arguments", progArgList
 
     (optionTable, argList) = parser.parse_args(progArgList)
+    if optionTable.addressSize != None:
+        LibCommand.setAddressSize(optionTable.addressSize)
 
     if len(argList) > 0: 
         name = argList[0]
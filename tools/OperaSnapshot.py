@@ -0,0 +1,268 @@
+#---------------------------------------------------------------------------
+#                                 OPERA
+#---------------------------------------------------------------------------
+# Author: agent
+# Copyright 2026 agent.
+#
+# This file is part of the OPERA.
+#
+# The OPERA is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or (at your
+# option) any later version.
+#
+# The OPERA is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+# http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+# 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+#---------------------------------------------------------------------------
+# Reader for the binary snapshots written by opera_snapshot_write
+# (lib/hipsens-snapshot.c). The result has the same keys as the
+# 'eond'/'eostc'/'serena' parts of opera_pywrite whenever possible.
+#---------------------------------------------------------------------------
+
+import struct, sys
+
+#---------------------------------------------------------------------------
+
+SnapshotMagic = b"OS"
+SnapshotVersion = 2
+
+SectionOpera = ord("O")
+SectionEond = ord("H")
+SectionEostc = ord("S")
+SectionSerena = ord("C")
+
+NeighState = { 0: "none", 1: "asym", 2: "sym" }
+TreeStatus = { 0: "none", 1: "has-parent", 2: "is-root" }
+ChildStatus = { 0: "none", 1: "unstable", 2: "stable" }
+
+TimeUndefined = -11 # `undefined_time' in hipsens-base.c
+
+#---------------------------------------------------------------------------
+
+class SnapshotError(Exception):
+    pass
+
+class SnapshotReader:
+    """Sequential reader of one snapshot, the functions get* follow the
+    buffer_get_* of hipsens-base.c (network order)"""
+
+    def __init__(self, data, addressSize):
+        self.data = data
+        self.pos = 0
+        self.addressSize = addressSize
+
+    def getStruct(self, spec):
+        size = struct.calcsize(spec)
+        if self.pos + size > len(self.data):
+            raise SnapshotError("truncated snapshot", self.pos)
+        result = struct.unpack(spec, self.data[self.pos:self.pos+size])
+        self.pos += size
+        return result
+
+    def getU8(self): return self.getStruct("!B")[0]
+    def getU16(self): return self.getStruct("!H")[0]
+    def getU32(self): return self.getStruct("!I")[0]
+
+    def getTime(self):
+        value = self.getStruct("!i")[0]
+        if value == TimeUndefined:
+            return None
+        return value
+
+    def getAddress(self):
+        value = self.data[self.pos:self.pos+self.addressSize]
+        if len(value) != self.addressSize:
+            raise SnapshotError("truncated snapshot", self.pos)
+        self.pos += self.addressSize
+        return "".join(["%02x" % x for x in bytearray(value)])
+
+    def getData(self, size):
+        value = self.data[self.pos:self.pos+size]
+        if len(value) != size:
+            raise SnapshotError("truncated snapshot", self.pos)
+        self.pos += size
+        return bytearray(value)
+
+    def getBits(self, nameList):
+        value = self.getU8()
+        return dict([(name, (value >> i) & 1)
+                     for i,name in enumerate(nameList)])
+
+#---------------------------------------------------------------------------
+
+def bitmapToList(bitmap):
+    return [i for i in range(len(bitmap)*8)
+            if bitmap[i // 8] & (1 << (i % 8))]
+
+def parseOpera(r):
+    result = r.getBits(["isColoredTreeRoot", "hasSetColor",
+                        "shouldStartSerena", "isBlocked", "shouldBeReset",
+                        "shouldIncColoredTreeSeq", "shouldStopStcGeneration"])
+    result["wakeupTime"] = r.getTime()
+    result["wakeupTimeBuffer"] = r.getTime()
+    result["cycleTransmitCount"] = r.getU8()
+    result["energyClass"] = r.getU8()
+    result["warningCount"] = r.getU8()
+    result["errorCount"] = r.getU8()
+    return result
+
+def parseEond(r):
+    result = { "type": "eond" }
+    result["helloSeqNum"] = r.getU16()
+    result["nextMsgHelloTime"] = r.getTime()
+    result["hasNeighborhoodChanged"] = r.getU8()
+    neighborTable = []
+    for i in range(r.getU16()):
+        neighbor = { "address": r.getAddress() }
+        neighbor["state"] = NeighState.get(r.getU8(), "???")
+        neighbor["symTime"] = r.getTime()
+        neighbor["asymTime"] = r.getTime()
+        neighbor["nb1hop"] = r.getU8()
+        neighbor["energyClass"] = r.getU8()
+        neighborTable.append(neighbor)
+    result["neighborTable"] = neighborTable
+    return result
+
+def parseSerenaTree(r):
+    result = { "flags": r.getU8() }
+    result.update(r.getBits(["shouldGenerateTreeStatus", "limitTreeStatus",
+                             "isSubtreeStable", "isNeighborhoodStable",
+                             "hasSentStable"]))
+    result["stabilityTime"] = r.getTime()
+    result["treeSeqNum"] = r.getU16()
+    childList = []
+    for i in range(r.getU16()):
+        child = { "address": r.getAddress() }
+        child["nbDescendant"] = r.getU16()
+        child["status"] = ChildStatus.get(r.getU8(), "???")
+        child["validityTime"] = r.getTime()
+        childList.append(child)
+    result["child"] = childList
+    return result
+
+def parseEostc(r):
+    result = { "type": "eostc" }
+    result["nextMsgStcTime"] = r.getTime()
+    myTreeIndex = r.getU16()
+    if myTreeIndex == 0xffff:
+        myTreeIndex = None
+    result["myTreeIndex"] = myTreeIndex
+    treeTable = []
+    for i in range(r.getU16()):
+        tree = { "index": r.getU16() }
+        tree["status"] = TreeStatus.get(r.getU8(), "???")
+        tree["rootAddress"] = r.getAddress()
+        tree["stcSeqNum"] = r.getU16()
+        tree["parentAddress"] = r.getAddress()
+        tree["currentCost"] = r.getU16()
+        tree["validityTime"] = r.getTime()
+        tree["receivedVtime"] = r.getU8()
+        tree["ttlIfGenerate"] = r.getU8()
+        if r.getU8():
+            tree["serenaInfo"] = parseSerenaTree(r)
+        else: tree["serenaInfo"] = None
+        treeTable.append(tree)
+    result["tree"] = treeTable
+    return result
+
+def parsePriorityList(r):
+    return [(r.getAddress(), r.getU32()) for i in range(r.getU8())]
+
+def parseSerena(r):
+    result = { "type": "serena" }
+    result.update(r.getBits(["isStarted", "isTopologySet", "isFinished"]))
+    result["colorSeqNum"] = r.getU16()
+    result["nextMsgColorTime"] = r.getTime()
+    result["color"] = r.getU8()
+    result["priority"] = r.getU32()
+    result["rootAddress"] = r.getAddress()
+    result["treeSeqNum"] = r.getU16()
+    result["lastNbColor"] = r.getU8()
+    result["finalNodeColor"] = r.getU8()
+    result["finalNeighborColorList"] = list(r.getData(r.getU8()))
+    bitmapSize = r.getU8()
+    result["colorBitmap1"] = bitmapToList(r.getData(bitmapSize))
+    result["colorBitmap2"] = bitmapToList(r.getData(bitmapSize))
+    result["colorBitmap3"] = bitmapToList(r.getData(bitmapSize))
+    neighborTable = []
+    for i in range(r.getU16()):
+        neighbor = { "address": r.getAddress() }
+        neighbor["color"] = r.getU8()
+        neighbor["priority"] = r.getU32()
+        neighbor.update(r.getBits(["hasPrio", "hasPrio1", "hasPrio2",
+                                   "isChild", "isParent", "hasSentMaxColor"]))
+        neighbor["childMaxColor"] = r.getU8()
+        neighbor["max2Prio1"] = parsePriorityList(r)
+        neighbor["max2Prio2"] = parsePriorityList(r)
+        neighborTable.append(neighbor)
+    result["neighborTable"] = neighborTable
+    return result
+
+SectionParser = {
+    SectionOpera: ("opera", parseOpera),
+    SectionEond: ("eond", parseEond),
+    SectionEostc: ("eostc", parseEostc),
+    SectionSerena: ("serena", parseSerena)
+}
+
+#---------------------------------------------------------------------------
+
+def parseSnapshot(data):
+    """Parse one snapshot at the beginning of `data',
+    returns (snapshot, remaining data)"""
+    if data[:2] != SnapshotMagic:
+        raise SnapshotError("bad magic")
+    (version, addressSize, totalSize) = struct.unpack("!BBH", data[2:6])
+    if version != SnapshotVersion:
+        raise SnapshotError("unsupported snapshot version", version)
+    if totalSize > len(data):
+        raise SnapshotError("truncated snapshot", totalSize)
+
+    r = SnapshotReader(data[:totalSize], addressSize)
+    r.pos = 6
+    result = { "type": "opera-snapshot", "version": version }
+    result["address"] = r.getAddress()
+    result["currentTime"] = r.getTime()
+    while r.pos < totalSize:
+        tag = r.getU8()
+        sectionSize = r.getU16()
+        sectionEnd = r.pos + sectionSize
+        if tag in SectionParser:
+            name, parseFunc = SectionParser[tag]
+            sectionReader = SnapshotReader(data[:sectionEnd], addressSize)
+            sectionReader.pos = r.pos
+            result[name] = parseFunc(sectionReader)
+        # unknown sections are skipped
+        r.pos = sectionEnd
+    return result, data[totalSize:]
+
+def parseSnapshotStream(data):
+    """Parse a sequence of concatenated snapshots"""
+    resultList = []
+    while len(data) > 0:
+        snapshot, data = parseSnapshot(data)
+        resultList.append(snapshot)
+    return resultList
+
+def readSnapshotFile(fileName):
+    f = open(fileName, "rb")
+    data = f.read()
+    f.close()
+    return parseSnapshotStream(data)
+
+#---------------------------------------------------------------------------
+
+if __name__ == "__main__":
+    import pprint
+    for fileName in sys.argv[1:]:
+        for snapshot in readSnapshotFile(fileName):
+            pprint.pprint(snapshot)
+
+#---------------------------------------------------------------------------
@@ -0,0 +1,131 @@
+#---------------------------------------------------------------------------
+#                                 OPERA
+#---------------------------------------------------------------------------
+# Author: agent
+# Copyright 2026 agent.
+#
+# This file is part of the OPERA.
+#
+# The OPERA is free software; you can redistribute it and/or modify
+# it under the terms of the GNU Lesser General Public License as published by
+# the Free Software Foundation; either version 3 of the License, or (at your
+# option) any later version.
+#
+# The OPERA is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+# or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public
+# License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public License
+# along with the OPERA; see the file LICENSE.LGPLv3.  If not, see
+# http://www.gnu.org/licenses/ or write to the Free Software Foundation, Inc.,
+# 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+#---------------------------------------------------------------------------
+# Decoder for the binary trace blocks written by base_state_trace_dump
+# (lib/hipsens-base.c), either in a file (concatenated blocks) or
+# returned by the serial command OPERA_GET_TRACE.
+#---------------------------------------------------------------------------
+
+import struct, sys
+
+#---------------------------------------------------------------------------
+
+TraceMagic = b"TR"
+TraceVersion = 1
+TraceNbArg = 3
+TraceRecordSpec = "!HBi" + "H"*TraceNbArg
+
+# must be kept in sync with opera_trace_event_t in lib/hipsens-base.h
+# event-id: (name, [argument names])
+TraceEvent = {
+    0x01: ("warning", ["line"]),
+    0x02: ("fatal", ["line"]),
+    0x03: ("packet-received", ["type", "size", "power"]),
+    0x04: ("packet-generated", ["type", "size", "cycleCount"]),
+
+    0x10: ("eond-hello-received", ["@sender", "seqNum", "power"]),
+    0x11: ("eond-hello-generated", ["seqNum", "size", "nbNeighbor"]),
+    0x12: ("eond-new-neighbor", ["@neighbor", "index", "power"]),
+    0x13: ("eond-neighbor-table-full", ["@neighbor", "power"]),
+    0x14: ("eond-neighbor-state-change", ["@neighbor", "oldState",
+                                          "newState"]),
+
+    0x20: ("eostc-stc-received", ["@sender", "@root", "stcSeqNum"]),
+    0x21: ("eostc-stc-generated", ["stcSeqNum", "treeSeqNum", "flags"]),
+    0x22: ("eostc-stc-repeated", ["@root", "stcSeqNum", "cost"]),
+    0x23: ("eostc-tree-status-generated", ["@root", "treeSeqNum",
+                                           "nbDescendant"]),
+    0x24: ("eostc-tree-table-full", ["@root", "stcSeqNum", "isColored"]),
+
+    0x30: ("serena-color-received", ["@sender", "color", "nbColor"]),
+    0x31: ("serena-color-generated", ["colorSeqNum", "color", "size"]),
+    0x32: ("serena-start", ["treeSeqNum", "nbNeighbor", "priority"])
+}
+
+#---------------------------------------------------------------------------
+
+class TraceError(Exception):
+    pass
+
+def hexAddress(data):
+    return "".join(["%02x" % x for x in bytearray(data)])
+
+def parseTraceBlock(data):
+    """Parse one block at the beginning of `data',
+    returns (node address, list of records, remaining data)"""
+    if data[:2] != TraceMagic:
+        raise TraceError("bad magic")
+    (version, addressSize) = struct.unpack("!BB", data[2:4])
+    if version != TraceVersion:
+        raise TraceError("unsupported trace version", version)
+    address = hexAddress(data[4:4+addressSize])
+    pos = 4+addressSize
+    nbRecord = struct.unpack("!B", data[pos:pos+1])[0]
+    pos += 1
+    recordSize = struct.calcsize(TraceRecordSpec)
+    recordList = []
+    for i in range(nbRecord):
+        if pos+recordSize > len(data):
+            raise TraceError("truncated trace block")
+        fieldList = struct.unpack(TraceRecordSpec, data[pos:pos+recordSize])
+        pos += recordSize
+        seqNum, event, time = fieldList[:3]
+        recordList.append((seqNum, event, time, list(fieldList[3:])))
+    return address, recordList, data[pos:]
+
+def parseTraceStream(data):
+    """Parse concatenated blocks, returns a list of (address, record)"""
+    result = []
+    while len(data) > 0:
+        address, recordList, data = parseTraceBlock(data)
+        result.extend([(address, record) for record in recordList])
+    return result
+
+def formatRecord(address, record):
+    seqNum, event, time, argList = record
+    name, argNameList = TraceEvent.get(event, ("event-%d" % event, []))
+    strArgList = []
+    for i, arg in enumerate(argList):
+        if i < len(argNameList):
+            argName = argNameList[i]
+            if argName.startswith("@"):
+                strArgList.append("%s=@%04x" % (argName[1:], arg))
+            else: strArgList.append("%s=%d" % (argName, arg))
+        elif arg != 0:
+            strArgList.append("arg%d=%d" % (i, arg))
+    return "%d %s #%d %s %s" % (time, address, seqNum, name,
+                                " ".join(strArgList))
+
+#---------------------------------------------------------------------------
+
+if __name__ == "__main__":
+    for fileName in sys.argv[1:]:
+        f = open(fileName, "rb")
+        data = f.read()
+        f.close()
+        entryList = parseTraceStream(data)
+        entryList.sort(key = lambda entry: (entry[1][2], entry[0]))
+        for address, record in entryList:
+            print(formatRecord(address, record))
+
+#---------------------------------------------------------------------------
@@ -1,32 +1,71 @@
-#--- file automatically generated by:
-#---   python LibCommand.py generate
+#--- constants of the module 'hipsens', used by LibCommand.py when it
+#--- cannot be imported: same content as the output of
+#--- 'python LibCommand.py generate' (which does not write this file),
+#--- to be kept in sync with opera_cmd_t in lib/hipsens-opera.c
 OPERA_INCREASE_TREE_SEQNUM = 46
 OPERA_ERASE_MY_TREE = 47
 OPERA_CMD_GET_VERSION = 1
 OPERA_ADDRESS_FILTER_SET = 80
+OPERA_ADDRESS_FILTER_GET = 81
+OPERA_ADDRESS_FILTER_ADD = 82
+OPERA_RESET_METRICS = 114
+OPERA_RESET_PROFILE = 116
+ADDRESS_SIZE = 2 # of the CC2530 target (lib/hipsens-cc2530.h)
 FilterOnlyAccept = 2
 FilterReject = 1
 FilterNone = 0
 OPERA_GET_ENERGY_CLASS = 23
+OPERA_GET_EOND_EVICTION_POLICY = 25
 OPERA_GET_EOND_HELLO_INTERVAL = 17
 OPERA_GET_EOND_NEIGH_HOLD_TIME = 19
 OPERA_GET_EOND_START_DELAY = 21
+OPERA_GET_EOSTC_CHILD_EVICTION_POLICY = 79
 OPERA_GET_EOSTC_STABILITY_TIME = 37
 OPERA_GET_EOSTC_START_DELAY = 42
 OPERA_GET_EOSTC_STC_INTERVAL = 33
+OPERA_GET_EOSTC_TREE_EVICTION_POLICY = 77
 OPERA_GET_EOSTC_TREE_HOLD_TIME = 35
+OPERA_GET_IMMEDIATE_RESPONSE = 67
+OPERA_GET_METRICS = 113
 OPERA_GET_MY_TREE = 44
+OPERA_GET_PROFILE = 115
+OPERA_GET_SERENA_CENTRAL_COLORING = 51
 OPERA_GET_SERENA_COLOR_INTERVAL = 49
+OPERA_GET_SERENA_CONFLICT_DISTANCE = 62
+OPERA_GET_SERENA_DESCENDANT_PER_SLOT = 58
+OPERA_GET_SERENA_MAX_COLOR_INTERVAL = 73
+OPERA_GET_SERENA_MAX_SUPPRESSED = 69
+OPERA_GET_SERENA_MIN_COLOR_INTERVAL = 71
+OPERA_GET_SERENA_NB_CHANNEL = 60
+OPERA_GET_SERENA_NB_SLOT = 56
+OPERA_GET_SERENA_SLOT_ORDER = 53
+OPERA_GET_SINK_LATENCY = 54
+OPERA_GET_TRACE = 112
 OPERA_GET_TRANSMIT_RATE_LIMIT = 65
 OPERA_GET_TREE_SEQNUM = 45
+OPERA_GET_TX_CLASS = 75
 OPERA_SET_ENERGY_CLASS = 22
+OPERA_SET_EOND_EVICTION_POLICY = 24
 OPERA_SET_EOND_HELLO_INTERVAL = 16
 OPERA_SET_EOND_NEIGH_HOLD_TIME = 18
 OPERA_SET_EOND_START_DELAY = 20
+OPERA_SET_EOSTC_CHILD_EVICTION_POLICY = 78
 OPERA_SET_EOSTC_STABILITY_TIME = 36
 OPERA_SET_EOSTC_START_DELAY = 41
 OPERA_SET_EOSTC_STC_INTERVAL = 32
+OPERA_SET_EOSTC_TREE_EVICTION_POLICY = 76
 OPERA_SET_EOSTC_TREE_HOLD_TIME = 34
+OPERA_SET_IMMEDIATE_RESPONSE = 66
 OPERA_SET_MY_TREE = 43
+OPERA_SET_SERENA_CENTRAL_COLORING = 50
 OPERA_SET_SERENA_COLOR_INTERVAL = 48
+OPERA_SET_SERENA_CONFLICT_DISTANCE = 61
+OPERA_SET_SERENA_DESCENDANT_PER_SLOT = 57
+OPERA_SET_SERENA_MAX_COLOR_INTERVAL = 72
+OPERA_SET_SERENA_MAX_SUPPRESSED = 68
+OPERA_SET_SERENA_MIN_COLOR_INTERVAL = 70
+OPERA_SET_SERENA_NB_CHANNEL = 59
+OPERA_SET_SERENA_NB_SLOT = 55
+OPERA_SET_SERENA_SLOT_ORDER = 52
 OPERA_SET_TRANSMIT_RATE_LIMIT = 64
+OPERA_SET_TX_CLASS = 74